@@ -0,0 +1,191 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include "utils.hpp"
+
+namespace dmk{
+    // An allocator hands out untyped blocks and is told the block size on
+    // release; containers hold it by value, so stateful allocators are
+    // handles to a shared resource.
+    //   void* allocate(std::size_t bytes);
+    //   void* reallocate(void* block, std::size_t oldBytes, std::size_t newBytes);
+    //   void deallocate(void* block, std::size_t bytes);
+    // reallocate is only used for trivially copyable items.
+
+    struct DefaultAllocator{
+        void* allocate(std::size_t bytes){return rawMemory<char>(bytes);}
+        void* reallocate(void* block, std::size_t, std::size_t newBytes)
+            {return rawReallocate((char*)block, newBytes);}
+        void deallocate(void* block, std::size_t){rawDelete(block);}
+    };
+
+    // Bump pointer allocation from a chain of growing blocks. Individual
+    // blocks are not released, only everything at once by reset.
+    class Arena{
+        enum{ALIGNMENT = alignof(std::max_align_t),
+            DEFAULT_BLOCK_SIZE = 1 << 16, MAX_BLOCK_SIZE = 1 << 26};
+        struct Block{
+            Block* next;
+            std::size_t size;
+        } *blocks;
+        char *next, *end, *last; // free space is [next, end)
+        std::size_t blockSize;
+        Arena(Arena const&);
+        Arena& operator=(Arena const&);
+
+        static std::size_t roundUp(std::size_t bytes)
+            {return (bytes + ALIGNMENT - 1) & ~std::size_t(ALIGNMENT - 1);}
+        static char* payload(Block* block){return (char*)block + roundUp(sizeof(Block));}
+
+        void addBlock(std::size_t bytes){
+            std::size_t size = std::max(blockSize, bytes);
+            Block* block = (Block*)rawMemory<char>(roundUp(sizeof(Block)) + size);
+            block->next = blocks;
+            block->size = size;
+            blocks = block;
+            next = payload(block);
+            end = next + size;
+            blockSize = std::min<std::size_t>(2 * blockSize, MAX_BLOCK_SIZE);
+        }
+
+        void deleteBlocks(Block* block){
+            while(block){
+                Block* toBeDeleted = block;
+                block = block->next;
+                rawDelete(toBeDeleted);
+            }
+        }
+    public:
+        Arena(std::size_t firstBlockSize = DEFAULT_BLOCK_SIZE): blocks(nullptr),
+            next(nullptr), end(nullptr), last(nullptr),
+            blockSize(roundUp(std::max<std::size_t>(firstBlockSize, ALIGNMENT))) {}
+
+        void* allocate(std::size_t bytes){
+            bytes = roundUp(std::max<std::size_t>(bytes, 1));
+            if(std::size_t(end - next) < bytes) addBlock(bytes);
+            last = next;
+            next += bytes;
+            return last;
+        }
+
+        void* reallocate(void* block, std::size_t oldBytes, std::size_t newBytes){
+            if(newBytes == 0){
+                deallocate(block, oldBytes);
+                return nullptr;
+            }
+            // the last allocation can grow or shrink in place
+            if(block && block == last && std::size_t(end - last) >= roundUp(newBytes)){
+                next = last + roundUp(newBytes);
+                return block;
+            }
+            if(newBytes <= oldBytes) return block;
+            void* result = allocate(newBytes);
+            if(block) std::memcpy(result, block, oldBytes);
+            return result;
+        }
+
+        void deallocate(void* block, std::size_t){
+            // only the last allocation can be given back
+            if(block && block == last){
+                next = last;
+                last = nullptr;
+            }
+        }
+
+        void reset(){
+            // keep the newest and largest block for reuse
+            if(blocks){
+                deleteBlocks(blocks->next);
+                blocks->next = nullptr;
+                next = payload(blocks);
+                end = next + blocks->size;
+            }
+            last = nullptr;
+        }
+
+        std::size_t getReservedBytes()const{
+            std::size_t result = 0;
+            for(Block* block = blocks; block; block = block->next)
+                result += block->size;
+            return result;
+        }
+
+        ~Arena(){deleteBlocks(blocks);}
+    };
+
+    // Power of two size classes, each with a free list, carved from an
+    // arena; large blocks go to the default allocator. Not thread safe.
+    class Pool{
+        enum{MIN_BYTES = 16, CLASSES = 8, MAX_BYTES = MIN_BYTES << (CLASSES - 1)};
+        struct FreeItem{FreeItem* next;} *freeLists[CLASSES];
+        Arena slabs;
+        Pool(Pool const&);
+        Pool& operator=(Pool const&);
+
+        static int sizeClass(std::size_t bytes){
+            int result = 0;
+            while((std::size_t(MIN_BYTES) << result) < bytes) ++result;
+            return result;
+        }
+    public:
+        Pool(std::size_t slabSize = 1 << 16): slabs(slabSize)
+            {std::fill(freeLists, freeLists + CLASSES, nullptr);}
+
+        void* allocate(std::size_t bytes){
+            if(bytes > MAX_BYTES) return rawMemory<char>(bytes);
+            int c = sizeClass(bytes);
+            FreeItem* result = freeLists[c];
+            if(!result) return slabs.allocate(std::size_t(MIN_BYTES) << c);
+            freeLists[c] = result->next;
+            return result;
+        }
+
+        void deallocate(void* block, std::size_t bytes){
+            if(!block) return;
+            if(bytes > MAX_BYTES) rawDelete(block);
+            else {
+                int c = sizeClass(bytes);
+                FreeItem* item = (FreeItem*)block;
+                item->next = freeLists[c];
+                freeLists[c] = item;
+            }
+        }
+
+        void* reallocate(void* block, std::size_t oldBytes, std::size_t newBytes){
+            if(block && oldBytes > MAX_BYTES && newBytes > MAX_BYTES)
+                return rawReallocate((char*)block, newBytes);
+            if(block && oldBytes <= MAX_BYTES && newBytes <= MAX_BYTES &&
+                sizeClass(oldBytes) == sizeClass(newBytes)) return block;
+            void* result = newBytes > 0 ? allocate(newBytes) : nullptr;
+            if(block && result) std::memcpy(result, block, std::min(oldBytes, newBytes));
+            deallocate(block, oldBytes);
+            return result;
+        }
+
+        // releases all pooled blocks at once, large ones must be
+        // deallocated individually
+        void reset(){
+            std::fill(freeLists, freeLists + CLASSES, nullptr);
+            slabs.reset();
+        }
+    };
+
+    // Allocator handles for use as container template arguments
+    template<typename RESOURCE> class ResourceAllocator{
+        RESOURCE* resource;
+    public:
+        ResourceAllocator(RESOURCE& theResource): resource(&theResource) {}
+        void* allocate(std::size_t bytes){return resource->allocate(bytes);}
+        void* reallocate(void* block, std::size_t oldBytes, std::size_t newBytes)
+            {return resource->reallocate(block, oldBytes, newBytes);}
+        void deallocate(void* block, std::size_t bytes)
+            {resource->deallocate(block, bytes);}
+    };
+    typedef ResourceAllocator<Arena> ArenaAllocator;
+    typedef ResourceAllocator<Pool> PoolAllocator;
+}
+
+#endif // ALLOCATOR_H
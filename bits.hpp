@@ -1,40 +1,49 @@
 #ifndef BITS_H
 #define BITS_H
 
+#include <climits>
 #include <limits>
 #include <cassert>
 #include "vector.hpp"
 #include "utils.hpp"
 
 namespace dmk{
-    unsigned long long twoPower(int x);
-    bool isPowerOfTwo(unsigned long long x);
+    // Single word primitives are inline so that hot loops can use them;
+    // the builtins compile to lzcnt/tzcnt/popcnt when the target has them.
+    constexpr unsigned long long twoPower(int x){return 1ull << x;}
+    constexpr bool isPowerOfTwo(unsigned long long x){return !(x & (x - 1));}
 
     // lg = binary logarithm
-    int lgFloor(unsigned long long x);
-    int lgCeiling(unsigned long long x);
-    unsigned long long nextPowerOfTwo(unsigned long long x);
+    constexpr int lgFloor(unsigned long long x){
+        assert(x);
+        return 63 - __builtin_clzll(x);
+    }
+    constexpr int lgCeiling(unsigned long long x){return lgFloor(x) + !isPowerOfTwo(x);}
+    constexpr unsigned long long nextPowerOfTwo(unsigned long long x){
+        return isPowerOfTwo(x) ? x : twoPower(lgFloor(x) + 1);}
 
     namespace bits{
         unsigned long long const ZERO = 0, FULL = ~ZERO;
-        bool get(unsigned long long x, int i);
-        bool flip(unsigned long long x, int i);
+        constexpr bool get(unsigned long long x, int i){return x & twoPower(i);}
+        constexpr bool flip(unsigned long long x, int i){return x ^ twoPower(i);}
         template<typename WORD> void set(WORD& x, int i, bool value){
             assert(!std::numeric_limits<WORD>::is_signed);
             if(value) x |= twoPower(i);
             else x &= ~twoPower(i);
         }
 
-        unsigned long long upperMask(int n);
-        unsigned long long lowerMask(int n);
-        unsigned long long middleMask(int i, int n);
-        unsigned long long getValue(unsigned long long x, int i, int n);
+        constexpr unsigned long long upperMask(int n){return n < 64 ? FULL << n : ZERO;}
+        constexpr unsigned long long lowerMask(int n){return ~upperMask(n);}
+        constexpr unsigned long long middleMask(int i, int n){return lowerMask(n) << i;}
+        constexpr unsigned long long getValue(unsigned long long x, int i, int n){
+            return (x >> i) & lowerMask(n);
+        }
 
         template<typename WORD>
         void setValue(WORD& x, unsigned long long value, int i, int n){
             assert(!std::numeric_limits<WORD>::is_signed);
             WORD mask = middleMask(i,n);
-            x &= mask;
+            x &= ~mask;
             x |= mask & (value << i);
         }
     }
@@ -58,8 +67,85 @@ namespace dmk{
         int operator()(unsigned char x)const {return table[x];}
     };
 
-    int popCountWord(unsigned long long x);
-    int rightmost0Count(unsigned long long x);
+    constexpr int popCountWord(unsigned long long x){
+#ifdef __POPCNT__
+        return __builtin_popcountll(x);
+#else
+        // without popcnt the builtin is a library call, count in parallel
+        x -= (x >> 1) & 0x5555555555555555ull;
+        x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+        return (((x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full) * 0x0101010101010101ull) >> 56;
+#endif
+    }
+    constexpr int rightmost0Count(unsigned long long x){
+        return x ? __builtin_ctzll(x) : 64;
+    }
+
+    namespace bits{
+        // Bulk operations over word arrays, generic versions are scalar
+        // loops, the overloads for 64 bit words, unsigned long long and on
+        // LP64 unsigned long, are dispatched at runtime to AVX2 or popcnt
+        // kernels when the cpu has them.
+        struct AndOp{template<typename WORD> static WORD apply(WORD a, WORD b){return a & b;}};
+        struct OrOp{template<typename WORD> static WORD apply(WORD a, WORD b){return a | b;}};
+        struct XorOp{template<typename WORD> static WORD apply(WORD a, WORD b){return a ^ b;}};
+        struct AndNotOp{template<typename WORD> static WORD apply(WORD a, WORD b){return a & ~b;}};
+
+        template<typename OP, typename WORD>
+        void combineWords(WORD* to, WORD const* from, long long n){
+            for(long long i = 0; i < n; ++i) to[i] = OP::apply(to[i], from[i]);
+        }
+        template<typename OP, typename WORD>
+        long long popCountCombined(WORD const* a, WORD const* b, long long n){
+            long long result = 0;
+            for(long long i = 0; i < n; ++i)
+                result += popCountWord(OP::apply(a[i], b[i]));
+            return result;
+        }
+        template<typename WORD> long long popCountWords(WORD const* words, long long n){
+            long long result = 0;
+            for(long long i = 0; i < n; ++i) result += popCountWord(words[i]);
+            return result;
+        }
+
+        void andWords(unsigned long long* to, unsigned long long const* from, long long n);
+        void orWords(unsigned long long* to, unsigned long long const* from, long long n);
+        void xorWords(unsigned long long* to, unsigned long long const* from, long long n);
+        void andNotWords(unsigned long long* to, unsigned long long const* from, long long n);
+        template<typename WORD> void andWords(WORD* to, WORD const* from, long long n)
+            {combineWords<AndOp>(to, from, n);}
+        template<typename WORD> void orWords(WORD* to, WORD const* from, long long n)
+            {combineWords<OrOp>(to, from, n);}
+        template<typename WORD> void xorWords(WORD* to, WORD const* from, long long n)
+            {combineWords<XorOp>(to, from, n);}
+        template<typename WORD> void andNotWords(WORD* to, WORD const* from, long long n)
+            {combineWords<AndNotOp>(to, from, n);}
+
+        long long popCountWords(unsigned long long const* words, long long n);
+        long long popCountAnd(unsigned long long const* a, unsigned long long const* b, long long n);
+        long long popCountOr(unsigned long long const* a, unsigned long long const* b, long long n);
+        long long popCountXor(unsigned long long const* a, unsigned long long const* b, long long n);
+        long long popCountAndNot(unsigned long long const* a, unsigned long long const* b, long long n);
+        template<typename WORD> long long popCountAnd(WORD const* a, WORD const* b, long long n)
+            {return popCountCombined<AndOp>(a, b, n);}
+        template<typename WORD> long long popCountOr(WORD const* a, WORD const* b, long long n)
+            {return popCountCombined<OrOp>(a, b, n);}
+        template<typename WORD> long long popCountXor(WORD const* a, WORD const* b, long long n)
+            {return popCountCombined<XorOp>(a, b, n);}
+        template<typename WORD> long long popCountAndNot(WORD const* a, WORD const* b, long long n)
+            {return popCountCombined<AndNotOp>(a, b, n);}
+#if ULONG_MAX == 0xffffffffffffffffull
+        void andWords(unsigned long* to, unsigned long const* from, long long n);
+        void orWords(unsigned long* to, unsigned long const* from, long long n);
+        void xorWords(unsigned long* to, unsigned long const* from, long long n);
+        void andNotWords(unsigned long* to, unsigned long const* from, long long n);
+        long long popCountWords(unsigned long const* words, long long n);
+        long long popCountAnd(unsigned long const* a, unsigned long const* b, long long n);
+        long long popCountOr(unsigned long const* a, unsigned long const* b, long long n);
+        long long popCountXor(unsigned long const* a, unsigned long const* b, long long n);
+        long long popCountAndNot(unsigned long const* a, unsigned long const* b, long long n);
+#endif
+    }
 
     class ReverseBits8{
         unsigned char table[256];
@@ -67,7 +153,7 @@ namespace dmk{
         template<typename WORD> static WORD reverseBitsBruteForce(WORD x){
             assert(!std::numeric_limits<WORD>::is_signed);
             WORD result = 0;
-            for(int i; i < std::numeric_limits<WORD>::digits; i++){
+            for(int i = 0; i < std::numeric_limits<WORD>::digits; i++){
                  result = (result << 1) + (x & 1);
                  x >>= 1;
             }
@@ -75,19 +161,27 @@ namespace dmk{
         }
 
         ReverseBits8(){
-            for(int i; i < 256; ++i){
+            for(int i = 0; i < 256; ++i){
                 table[i] = reverseBitsBruteForce<unsigned char>(i);
             }
         }
         unsigned char operator()(unsigned char x)const{return table[x];}
     };
 
-    template<typename WORD> WORD reverseBits(WORD x){
-        assert(!std::numeric_limits<WORD>::is_signed);
-        static ReverseBits8 r8;
-        WORD result = 0;
-        for(int i=0; i < sizeof(x); ++i, x >>=8) result = (result << 8) + r8(x);
-        return result;
+    // swaps ever larger groups of bits, bytes at once
+    template<typename WORD> constexpr WORD reverseBits(WORD x){
+        static_assert(!std::numeric_limits<WORD>::is_signed, "unsigned words only");
+        enum{B = std::numeric_limits<WORD>::digits};
+        x = WORD(((x >> 1) & WORD(0x5555555555555555ull)) | ((x & WORD(0x5555555555555555ull)) << 1));
+        x = WORD(((x >> 2) & WORD(0x3333333333333333ull)) | ((x & WORD(0x3333333333333333ull)) << 2));
+        x = WORD(((x >> 4) & WORD(0x0f0f0f0f0f0f0f0full)) | ((x & WORD(0x0f0f0f0f0f0f0f0full)) << 4));
+        if constexpr(B == 64) return __builtin_bswap64(x);
+        else if constexpr(B == 32) return __builtin_bswap32(x);
+        else if constexpr(B == 16) return __builtin_bswap16(x);
+        else{
+            static_assert(B == 8, "8 to 64 bit words");
+            return x;
+        }
     }
 
     template<typename WORD> WORD reverseBits(WORD x, int n){
@@ -96,18 +190,18 @@ namespace dmk{
         return reverseBits<WORD>(x & bits::lowerMask(n)) >> shift;
     }
 
-    template<typename WORD = unsigned long long>
+    template<typename WORD = unsigned long long, typename ALLOCATOR = DefaultAllocator>
     class Bitset{
         enum{B = std::numeric_limits<WORD>::digits};
         unsigned long long bitSize;
-        Vector<WORD> storage;
+        Vector<WORD, ALLOCATOR> storage;
 
         void zeroOutRemainder(){
-            if(bitSize > 0) storage.lastItems() &= bits::lowerMask(lastWordBits());
+            if(garbageBits() > 0) storage.lastItem() &= bits::lowerMask(lastWordBits());
         }
 
-        bool get(int i) const{
-            assert(i >= 0 && i < bitSize);
+        bool get(unsigned long long i) const{
+            assert(i < bitSize);
             return bits::get(storage[i/B], i % B);
         }
 
@@ -115,13 +209,19 @@ namespace dmk{
 
     public:
 
-        Bitset(unsigned long long initialSize = 0) :
+        Bitset(unsigned long long initialSize = 0,
+            ALLOCATOR const& theAllocator = ALLOCATOR()) :
             bitSize(initialSize),
-
-            storage(wordsNeeded()) {}
-        Bitset(Vector<WORD> const& vector) :
+            storage(wordsNeeded(), 0, theAllocator) {}
+        Bitset(Vector<WORD, ALLOCATOR> const& vector) :
             bitSize(B * vector.getSize()),
             storage(vector) {}
+        Bitset(Vector<WORD, ALLOCATOR> const& vector, unsigned long long theBitSize) :
+            bitSize(theBitSize),
+            storage(vector) {
+            assert(wordSize() == wordsNeeded());
+            zeroOutRemainder();
+        }
 
         int lastWordBits()const{
             assert(bitSize > 0);
@@ -131,14 +231,14 @@ namespace dmk{
         }
 
         int garbageBits()const{return bitSize > 0 ? B - lastWordBits() : 0;}
-        Vector<WORD> const& getStorage()const{return storage;}
+        Vector<WORD, ALLOCATOR> const& getStorage()const{return storage;}
         unsigned long long getSize()const{return bitSize;}
         unsigned long long wordSize()const{return storage.getSize();}
 
-        bool operator[](int i)const {return get(i);}
+        bool operator[](unsigned long long i)const {return get(i);}
 
-        void set(int i, bool value = true){
-            assert(i >=0 && i < bitSize);
+        void set(unsigned long long i, bool value = true){
+            assert(i < bitSize);
             bits::set(storage[i/B], i%B, value);
         }
 
@@ -156,11 +256,26 @@ namespace dmk{
         bool operator==(Bitset const& rhs)const{return storage == rhs.storage;}
         Bitset& operator&=(Bitset const& rhs){
             assert(bitSize == rhs.bitSize);
-            for(int i = 0; i < wordSize(); ++i) storage[i] &= rhs.storage[i];
+            bits::andWords(storage.getArray(), rhs.storage.getArray(), wordSize());
+            return *this;
+        }
+        Bitset& operator|=(Bitset const& rhs){
+            assert(bitSize == rhs.bitSize);
+            bits::orWords(storage.getArray(), rhs.storage.getArray(), wordSize());
+            return *this;
+        }
+        Bitset& operator^=(Bitset const& rhs){
+            assert(bitSize == rhs.bitSize);
+            bits::xorWords(storage.getArray(), rhs.storage.getArray(), wordSize());
+            return *this;
+        }
+        Bitset& andNot(Bitset const& rhs){
+            assert(bitSize == rhs.bitSize);
+            bits::andNotWords(storage.getArray(), rhs.storage.getArray(), wordSize());
             return *this;
         }
         void flip(){
-            for(int i = 0; i < wordSize(); ++i) storage[i] &= ~storage[i];
+            for(unsigned long long i = 0; i < wordSize(); ++i) storage[i] = ~storage[i];
             zeroOutRemainder();
         }
         Bitset operator >>=(int shift){
@@ -210,6 +325,84 @@ namespace dmk{
             zeroOutRemainder();
         }
 
+        // positions of the nearest set or clear bits, -1 if none
+        long long nextSetBit(unsigned long long i)const{
+            if(i >= bitSize) return -1;
+            long long word = i / B;
+            WORD x = storage[word] & ~WORD(bits::lowerMask(i % B));
+            while(!x){ // skip zero words
+                if(++word >= (long long)wordSize()) return -1;
+                x = storage[word];
+            }
+            return word * B + rightmost0Count(x);
+        }
+        long long prevSetBit(unsigned long long i)const{
+            if(bitSize == 0) return -1;
+            if(i >= bitSize) i = bitSize - 1;
+            long long word = i / B;
+            WORD x = storage[word] & WORD(WORD(~WORD(0)) >> (B - 1 - i % B));
+            while(!x){
+                if(--word < 0) return -1;
+                x = storage[word];
+            }
+            return word * B + lgFloor(x);
+        }
+        long long nextClearBit(unsigned long long i)const{
+            if(i >= bitSize) return -1;
+            long long word = i / B;
+            WORD x = ~storage[word] & ~WORD(bits::lowerMask(i % B));
+            while(!x){ // skip full words
+                if(++word >= (long long)wordSize()) return -1;
+                x = ~storage[word];
+            }
+            unsigned long long result = word * B + rightmost0Count(x);
+            return result < bitSize ? result : -1;
+        }
+
+        // calls f with the position of every set bit, in increasing order
+        template<typename FUNCTION> void forEachSetBit(FUNCTION f)const{
+            for(unsigned long long word = 0; word < wordSize(); ++word)
+                for(WORD x = storage[word]; x; x &= x - 1)
+                    f(word * B + rightmost0Count(x));
+        }
+
+        class SetBitIterator{
+            WORD const* words;
+            long long word, wordCount;
+            WORD remaining; // set bits of the current word not yet visited
+            void skipZeroWords(){
+                while(!remaining && ++word < wordCount) remaining = words[word];
+                if(!remaining) word = wordCount;
+            }
+        public:
+            SetBitIterator(WORD const* theWords, long long theWordCount, long long start):
+                words(theWords), word(start), wordCount(theWordCount),
+                remaining(start < theWordCount ? theWords[start] : 0) {skipZeroWords();}
+            unsigned long long operator*()const{
+                assert(remaining);
+                return word * B + rightmost0Count(remaining);
+            }
+            SetBitIterator& operator++(){
+                assert(remaining);
+                remaining &= remaining - 1;
+                skipZeroWords();
+                return *this;
+            }
+            bool operator==(SetBitIterator const& rhs)const
+                {return word == rhs.word && remaining == rhs.remaining;}
+            bool operator!=(SetBitIterator const& rhs)const{return !(*this == rhs);}
+        };
+        SetBitIterator beginSetBits()const
+            {return SetBitIterator(storage.getArray(), wordSize(), 0);}
+        SetBitIterator endSetBits()const
+            {return SetBitIterator(storage.getArray(), wordSize(), wordSize());}
+        struct SetBits{ // for range based loops
+            Bitset const& b;
+            SetBitIterator begin()const{return b.beginSetBits();}
+            SetBitIterator end()const{return b.endSetBits();}
+        };
+        SetBits setBits()const{return SetBits{*this};}
+
         bool isZero()const{
             for(int i = 0; i < wordSize(); ++i)
                 if(storage[i]) return false;
@@ -256,21 +449,36 @@ namespace dmk{
         }
 
         void reverse(){
-            int nFill = garbageBits();
-            bitSize += nFill;
-            (*this)<<=(nFill);
+            // reverse whole words, then shift out the former garbage bits
+            int nFill = garbageBits(), n = wordSize();
             storage.reverse();
-            for(int i = 0; i < wordSize(); ++i)
-                storage[i]= reverseBits(storage[i]);
-            bitSize -= nFill;
-            zeroOutRemainder();
+            for(int i = 0; i < n; ++i) storage[i] = reverseBits(storage[i]);
+            if(nFill > 0){
+                for(int i = 0; i + 1 < n; ++i)
+                    storage[i] = WORD(storage[i] >> nFill) | WORD(storage[i + 1] << (B - nFill));
+                storage[n - 1] >>= nFill;
+            }
         }
 
-        int popCount()const{
-            int sum = 0;
-            for(int i = 0; i < wordSize(); ++i)
-                sum += popCountWord(storage[i]);
-            return sum;
+        long long popCount()const{
+            return bits::popCountWords(storage.getArray(), wordSize());
+        }
+        // counts of a combination with rhs, without computing it
+        long long popCountAnd(Bitset const& rhs)const{
+            assert(bitSize == rhs.bitSize);
+            return bits::popCountAnd(storage.getArray(), rhs.storage.getArray(), wordSize());
+        }
+        long long popCountOr(Bitset const& rhs)const{
+            assert(bitSize == rhs.bitSize);
+            return bits::popCountOr(storage.getArray(), rhs.storage.getArray(), wordSize());
+        }
+        long long popCountXor(Bitset const& rhs)const{
+            assert(bitSize == rhs.bitSize);
+            return bits::popCountXor(storage.getArray(), rhs.storage.getArray(), wordSize());
+        }
+        long long popCountAndNot(Bitset const& rhs)const{
+            assert(bitSize == rhs.bitSize);
+            return bits::popCountAndNot(storage.getArray(), rhs.storage.getArray(), wordSize());
         }
     };
 
@@ -0,0 +1,510 @@
+#ifndef COMPRESSEDBITMAP_H
+#define COMPRESSEDBITMAP_H
+
+#include <algorithm>
+#include "utils.hpp"
+#include "bits.hpp"
+#include "vector.hpp"
+#include "smallvector.hpp"
+
+namespace dmk{
+
+    // Roaring style set of 32 bit values. The high 16 bits select a chunk,
+    // which keeps its low 16 bits as a sorted array when it has at most
+    // 4096 of them, else as a 65536 bit bitmap, or after runOptimize as
+    // a list of runs when that is smaller.
+    class CompressedBitmap{
+        enum{CHUNK_BITS = 16, CHUNK_SIZE = 1 << CHUNK_BITS,
+            WORDS = CHUNK_SIZE / 64, ARRAY_MAX = 4096};
+        typedef unsigned short Low;
+    public:
+        enum Operation{AND, OR, XOR, AND_NOT};
+    private:
+        struct Container{
+            enum Type{ARRAY, BITMAP, RUN} type;
+            int cardinality;
+            SmallVector<Low, 0> values; // array items or run (start, length - 1)
+            SmallVector<unsigned long long, 0> words; // bitmap
+
+            Container(): type(ARRAY), cardinality(0) {}
+
+            int runCount()const{return values.getSize() / 2;}
+            int runStart(int r)const{return values[2 * r];}
+            int runEnd(int r)const{return values[2 * r] + values[2 * r + 1];}
+
+            template<typename FUNCTION> void forEach(FUNCTION f)const{
+                if(type == ARRAY)
+                    for(int i = 0; i < cardinality; ++i) f(values[i]);
+                else if(type == BITMAP){
+                    for(int w = 0; w < WORDS; ++w)
+                        for(unsigned long long x = words[w]; x; x &= x - 1)
+                            f(w * 64 + rightmost0Count(x));
+                }
+                else for(int r = 0; r < runCount(); ++r)
+                    for(int x = runStart(r); x <= runEnd(r); ++x) f(x);
+            }
+
+            // after the last run, joining it when they overlap or touch
+            void appendRun(int start, int end){
+                int size = values.getSize();
+                if(size > 0 && values[size - 2] + values[size - 1] + 1 >= start){
+                    int last = values[size - 2] + values[size - 1];
+                    if(end > last){
+                        values[size - 1] += end - last;
+                        cardinality += end - last;
+                    }
+                }
+                else {
+                    values.append(start);
+                    values.append(end - start);
+                    cardinality += end - start + 1;
+                }
+            }
+
+            bool contains(Low x)const{
+                if(type == BITMAP) return words[x / 64] >> (x % 64) & 1;
+                if(type == ARRAY) return std::binary_search(values.getArray(),
+                    values.getArray() + cardinality, x);
+                // find the last run starting at or before x
+                int left = 0, right = runCount() - 1;
+                while(left <= right){
+                    int middle = left + (right - left) / 2;
+                    if(runStart(middle) <= x) left = middle + 1;
+                    else right = middle - 1;
+                }
+                return right >= 0 && x <= runEnd(right);
+            }
+
+            int countRuns()const{
+                if(type == RUN) return runCount();
+                int result = 0, last = -2;
+                forEach([&](int x){
+                    if(x != last + 1) ++result;
+                    last = x;
+                });
+                return result;
+            }
+
+            void toBitmap(){
+                SmallVector<unsigned long long, 0> result(WORDS, 0);
+                forEach([&](int x){result[x / 64] |= 1ull << (x % 64);});
+                words = std::move(result);
+                values = SmallVector<Low, 0>();
+                type = BITMAP;
+            }
+            void toArray(){
+                assert(cardinality <= ARRAY_MAX);
+                SmallVector<Low, 0> result;
+                result.reserve(cardinality);
+                forEach([&](int x){result.append(x);});
+                values = std::move(result);
+                words = SmallVector<unsigned long long, 0>();
+                type = ARRAY;
+            }
+            void toRuns(){
+                SmallVector<Low, 0> result;
+                forEach([&](int x){
+                    int size = result.getSize();
+                    if(size > 0 && result[size - 2] + result[size - 1] + 1 == x)
+                        ++result[size - 1];
+                    else {
+                        result.append(x);
+                        result.append(0);
+                    }
+                });
+                values = std::move(result);
+                words = SmallVector<unsigned long long, 0>();
+                type = RUN;
+            }
+
+            // runs become an array or a bitmap, for updates and most operations
+            void materialize(){
+                if(type == RUN){
+                    if(cardinality > ARRAY_MAX) toBitmap();
+                    else toArray();
+                }
+            }
+            void normalize(){
+                if(type == ARRAY && cardinality > ARRAY_MAX) toBitmap();
+                else if(type == BITMAP && cardinality <= ARRAY_MAX) toArray();
+            }
+            // the smallest of the three representations
+            void optimize(){
+                int runBytes = 4 * countRuns(), otherBytes =
+                    cardinality > ARRAY_MAX ? 8 * WORDS : 2 * cardinality;
+                if(runBytes < otherBytes){
+                    if(type != RUN) toRuns();
+                }
+                else {
+                    materialize();
+                    normalize();
+                }
+            }
+
+            bool add(Low x){
+                materialize();
+                if(type == BITMAP){
+                    unsigned long long& word = words[x / 64], bit = 1ull << (x % 64);
+                    if(word & bit) return false;
+                    word |= bit;
+                }
+                else {
+                    int i = std::lower_bound(values.getArray(),
+                        values.getArray() + cardinality, x) - values.getArray();
+                    if(i < cardinality && values[i] == x) return false;
+                    values.append(x);
+                    for(int j = cardinality; j > i; --j) values[j] = values[j - 1];
+                    values[i] = x;
+                }
+                ++cardinality;
+                normalize();
+                return true;
+            }
+            bool remove(Low x){
+                if(!contains(x)) return false;
+                materialize();
+                if(type == BITMAP) words[x / 64] &= ~(1ull << (x % 64));
+                else {
+                    int i = std::lower_bound(values.getArray(),
+                        values.getArray() + cardinality, x) - values.getArray();
+                    for(int j = i; j + 1 < cardinality; ++j) values[j] = values[j + 1];
+                    values.removeLast();
+                }
+                --cardinality;
+                normalize();
+                return true;
+            }
+        };
+
+        Vector<Low> keys; // sorted high halves, one per container
+        Vector<Container> containers;
+
+        int lowerBound(Low key)const{
+            return std::lower_bound(keys.getArray(), keys.getArray() +
+                keys.getSize(), key) - keys.getArray();
+        }
+        int find(Low key)const{
+            int i = lowerBound(key);
+            return i < keys.getSize() && keys[i] == key ? i : -1;
+        }
+
+        static Container combineRuns(Container const& a, Container const& b, Operation op){
+            // two pointer intersection or union of the sorted runs
+            assert(op == AND || op == OR);
+            Container result;
+            result.type = Container::RUN;
+            for(int i = 0, j = 0; i < a.runCount() || j < b.runCount();){
+                if(op == AND){
+                    if(i >= a.runCount() || j >= b.runCount()) break;
+                    int start = std::max(a.runStart(i), b.runStart(j)),
+                        end = std::min(a.runEnd(i), b.runEnd(j));
+                    if(start <= end) result.appendRun(start, end);
+                    a.runEnd(i) < b.runEnd(j) ? ++i : ++j;
+                }
+                else if(j >= b.runCount() || (i < a.runCount() &&
+                    a.runStart(i) <= b.runStart(j))){
+                    result.appendRun(a.runStart(i), a.runEnd(i));
+                    ++i;
+                }
+                else {
+                    result.appendRun(b.runStart(j), b.runEnd(j));
+                    ++j;
+                }
+            }
+            return result;
+        }
+
+        // OR, XOR or AND_NOT of the bits in [start, end]
+        static void updateRange(unsigned long long* words, int start, int end, Operation op){
+            for(int w = start / 64; w <= end / 64; ++w){
+                unsigned long long mask = ~0ull;
+                if(w == start / 64) mask &= ~0ull << (start % 64);
+                if(w == end / 64) mask &= ~0ull >> (63 - end % 64);
+                if(op == OR) words[w] |= mask;
+                else if(op == XOR) words[w] ^= mask;
+                else words[w] &= ~mask;
+            }
+        }
+
+        // updates a copy of the bitmap a range per run
+        static Container combineRunsBitmap(Container const& a, Container const& b, Operation op){
+            Container const& runs = a.type == Container::RUN ? a : b;
+            Container result = a.type == Container::RUN ? b : a;
+            unsigned long long* words = result.words.getArray();
+            if(op == AND || (op == AND_NOT && a.type == Container::RUN)){
+                // flip inside the runs to subtract the bitmap, clear the gaps
+                int next = 0;
+                for(int r = 0; r < runs.runCount(); ++r){
+                    if(op == AND_NOT) updateRange(words, runs.runStart(r), runs.runEnd(r), XOR);
+                    if(runs.runStart(r) > next)
+                        updateRange(words, next, runs.runStart(r) - 1, AND_NOT);
+                    next = runs.runEnd(r) + 1;
+                }
+                if(next < CHUNK_SIZE) updateRange(words, next, CHUNK_SIZE - 1, AND_NOT);
+            }
+            else for(int r = 0; r < runs.runCount(); ++r)
+                updateRange(words, runs.runStart(r), runs.runEnd(r), op);
+            result.cardinality = bits::popCountWords(words, WORDS);
+            result.normalize();
+            return result;
+        }
+
+        // AND or AND_NOT in one pass over the array and the runs
+        static Container combineRunsArray(Container const& a, Container const& b, Operation op){
+            assert(op == AND || op == AND_NOT);
+            Container result;
+            if(a.type == Container::RUN && op == AND_NOT){
+                // cut the array items out of the runs
+                result.type = Container::RUN;
+                for(int r = 0, i = 0; r < a.runCount(); ++r){
+                    int start = a.runStart(r), end = a.runEnd(r);
+                    for(; i < b.cardinality && b.values[i] < start; ++i);
+                    for(; i < b.cardinality && b.values[i] <= end; ++i){
+                        if(b.values[i] > start) result.appendRun(start, b.values[i] - 1);
+                        start = b.values[i] + 1;
+                    }
+                    if(start <= end) result.appendRun(start, end);
+                }
+                result.optimize();
+                return result;
+            }
+            // keep the array items inside the runs, or outside for AND_NOT
+            Container const& array = a.type == Container::ARRAY ? a : b,
+                &runs = a.type == Container::ARRAY ? b : a;
+            bool isAnd = op == AND;
+            for(int i = 0, r = 0; i < array.cardinality; ++i){
+                Low x = array.values[i];
+                for(; r < runs.runCount() && runs.runEnd(r) < x; ++r);
+                if((r < runs.runCount() && runs.runStart(r) <= x) == isAnd)
+                    result.values.append(x);
+            }
+            result.cardinality = result.values.getSize();
+            return result;
+        }
+
+        static Container combine(Container const& a, Container const& b, Operation op){
+            if(a.type == Container::RUN || b.type == Container::RUN){
+                if(a.type == b.type && (op == AND || op == OR)){
+                    Container result = combineRuns(a, b, op);
+                    result.optimize();
+                    return result;
+                }
+                if(a.type == Container::BITMAP || b.type == Container::BITMAP)
+                    return combineRunsBitmap(a, b, op);
+                if(a.type != b.type && (op == AND || op == AND_NOT))
+                    return combineRunsArray(a, b, op);
+                Container x(a), y(b);
+                x.materialize();
+                y.materialize();
+                return combine(x, y, op);
+            }
+            Container result;
+            if(a.type == Container::ARRAY && b.type == Container::ARRAY){
+                Low buffer[2 * ARRAY_MAX], *end = buffer;
+                Low const *x = a.values.getArray(), *y = b.values.getArray();
+                if(op == AND) end = std::set_intersection(x, x + a.cardinality,
+                    y, y + b.cardinality, buffer);
+                else if(op == OR) end = std::set_union(x, x + a.cardinality,
+                    y, y + b.cardinality, buffer);
+                else if(op == XOR) end = std::set_symmetric_difference(x,
+                    x + a.cardinality, y, y + b.cardinality, buffer);
+                else end = std::set_difference(x, x + a.cardinality,
+                    y, y + b.cardinality, buffer);
+                result.cardinality = end - buffer;
+                result.values.reserve(result.cardinality);
+                for(Low* p = buffer; p < end; ++p) result.values.append(*p);
+            }
+            else if(a.type == Container::BITMAP && b.type == Container::BITMAP){
+                result = a;
+                unsigned long long* to = result.words.getArray();
+                unsigned long long const* from = b.words.getArray();
+                if(op == AND) bits::andWords(to, from, WORDS);
+                else if(op == OR) bits::orWords(to, from, WORDS);
+                else if(op == XOR) bits::xorWords(to, from, WORDS);
+                else bits::andNotWords(to, from, WORDS);
+                result.cardinality = bits::popCountWords(to, WORDS);
+            }
+            else if(op == AND || (op == AND_NOT && a.type == Container::ARRAY)){
+                // filter the array by membership in the bitmap
+                bool isAnd = op == AND;
+                Container const& array = a.type == Container::ARRAY ? a : b,
+                    &bitmap = a.type == Container::ARRAY ? b : a;
+                for(int i = 0; i < array.cardinality; ++i)
+                    if(bitmap.contains(array.values[i]) == isAnd)
+                        result.values.append(array.values[i]);
+                result.cardinality = result.values.getSize();
+            }
+            else { // update a copy of the bitmap with the array items
+                Container const& array = a.type == Container::ARRAY ? a : b;
+                result = a.type == Container::ARRAY ? b : a;
+                for(int i = 0; i < array.cardinality; ++i){
+                    Low x = array.values[i];
+                    unsigned long long& word = result.words[x / 64], bit = 1ull << (x % 64);
+                    if(op == OR) word |= bit;
+                    else if(op == XOR) word ^= bit;
+                    else word &= ~bit;
+                }
+                result.cardinality = bits::popCountWords(result.words.getArray(), WORDS);
+            }
+            result.normalize();
+            return result;
+        }
+
+        void appendChunk(Low key, Container&& container){
+            if(container.cardinality > 0){
+                keys.append(key);
+                containers.append(std::move(container));
+            }
+        }
+    public:
+        CompressedBitmap() {}
+
+        template<typename ALLOCATOR>
+        explicit CompressedBitmap(Bitset<unsigned long long, ALLOCATOR> const& bitset){
+            assert(bitset.getSize() <= (1ull << 32));
+            unsigned long long const* words = bitset.getStorage().getArray();
+            long long wordCount = bitset.wordSize();
+            for(long long first = 0; first < wordCount; first += WORDS){
+                int n = std::min<long long>(WORDS, wordCount - first);
+                Container c;
+                c.cardinality = bits::popCountWords(words + first, n);
+                if(c.cardinality > ARRAY_MAX){
+                    c.type = Container::BITMAP;
+                    c.words = SmallVector<unsigned long long, 0>(WORDS, 0);
+                    for(int w = 0; w < n; ++w) c.words[w] = words[first + w];
+                }
+                else for(int w = 0; w < n; ++w)
+                    for(unsigned long long x = words[first + w]; x; x &= x - 1)
+                        c.values.append(w * 64 + rightmost0Count(x));
+                appendChunk(first / WORDS, std::move(c));
+            }
+        }
+
+        // all values must be below size
+        Bitset<> toBitset(unsigned long long size)const{
+            Vector<unsigned long long> words(ceiling(size, 64), 0);
+            for(int i = 0; i < keys.getSize(); ++i){
+                unsigned long long base = (unsigned long long)keys[i] << CHUNK_BITS;
+                Container const& c = containers[i];
+                if(c.type == Container::BITMAP)
+                    for(int w = 0; w < WORDS; ++w){
+                        if(!c.words[w]) continue;
+                        assert(base / 64 + w < (unsigned long long)words.getSize());
+                        words[base / 64 + w] = c.words[w];
+                    }
+                else c.forEach([&](int x){
+                    assert(base + (unsigned long long)x < size);
+                    words[(base + x) / 64] |= 1ull << (x % 64);
+                });
+            }
+            return Bitset<>(words, size);
+        }
+
+        bool contains(unsigned int x)const{
+            int i = find(x >> CHUNK_BITS);
+            return i != -1 && containers[i].contains(x);
+        }
+
+        bool add(unsigned int x){
+            Low key = x >> CHUNK_BITS;
+            int i = lowerBound(key);
+            if(i == keys.getSize() || keys[i] != key){
+                // insert an empty container, shifting later ones right
+                keys.append(key);
+                containers.append(Container());
+                for(int j = keys.getSize() - 1; j > i; --j){
+                    keys[j] = keys[j - 1];
+                    containers[j] = std::move(containers[j - 1]);
+                }
+                keys[i] = key;
+                containers[i] = Container();
+            }
+            return containers[i].add(x);
+        }
+
+        bool remove(unsigned int x){
+            int i = find(x >> CHUNK_BITS);
+            if(i == -1 || !containers[i].remove(x)) return false;
+            if(containers[i].cardinality == 0){
+                for(int j = i; j + 1 < keys.getSize(); ++j){
+                    keys[j] = keys[j + 1];
+                    containers[j] = std::move(containers[j + 1]);
+                }
+                keys.removeLast();
+                containers.removeLast();
+            }
+            return true;
+        }
+
+        unsigned long long getCardinality()const{
+            unsigned long long result = 0;
+            for(int i = 0; i < containers.getSize(); ++i)
+                result += containers[i].cardinality;
+            return result;
+        }
+        bool isEmpty()const{return keys.getSize() == 0;}
+
+        // calls f with every value in increasing order
+        template<typename FUNCTION> void forEach(FUNCTION f)const{
+            for(int i = 0; i < keys.getSize(); ++i){
+                unsigned int base = (unsigned int)keys[i] << CHUNK_BITS;
+                containers[i].forEach([&](int x){f(base | x);});
+            }
+        }
+
+        // converts containers to runs where that saves space
+        void runOptimize(){
+            for(int i = 0; i < containers.getSize(); ++i) containers[i].optimize();
+        }
+
+        static CompressedBitmap combine(CompressedBitmap const& a,
+            CompressedBitmap const& b, Operation op){
+            // merge the sorted chunk keys, combining chunks present in both
+            CompressedBitmap result;
+            int i = 0, j = 0;
+            while(i < a.keys.getSize() && j < b.keys.getSize()){
+                if(a.keys[i] == b.keys[j]){
+                    result.appendChunk(a.keys[i], combine(a.containers[i],
+                        b.containers[j], op));
+                    ++i;
+                    ++j;
+                }
+                else if(a.keys[i] < b.keys[j]){
+                    if(op != AND) result.appendChunk(a.keys[i], Container(a.containers[i]));
+                    ++i;
+                }
+                else {
+                    if(op == OR || op == XOR)
+                        result.appendChunk(b.keys[j], Container(b.containers[j]));
+                    ++j;
+                }
+            }
+            if(op != AND) for(; i < a.keys.getSize(); ++i)
+                result.appendChunk(a.keys[i], Container(a.containers[i]));
+            if(op == OR || op == XOR) for(; j < b.keys.getSize(); ++j)
+                result.appendChunk(b.keys[j], Container(b.containers[j]));
+            return result;
+        }
+
+        CompressedBitmap& operator&=(CompressedBitmap const& rhs)
+            {return *this = combine(*this, rhs, AND);}
+        CompressedBitmap& operator|=(CompressedBitmap const& rhs)
+            {return *this = combine(*this, rhs, OR);}
+        CompressedBitmap& operator^=(CompressedBitmap const& rhs)
+            {return *this = combine(*this, rhs, XOR);}
+        CompressedBitmap& andNot(CompressedBitmap const& rhs)
+            {return *this = combine(*this, rhs, AND_NOT);}
+        friend CompressedBitmap operator&(CompressedBitmap const& a, CompressedBitmap const& b)
+            {return combine(a, b, AND);}
+        friend CompressedBitmap operator|(CompressedBitmap const& a, CompressedBitmap const& b)
+            {return combine(a, b, OR);}
+        friend CompressedBitmap operator^(CompressedBitmap const& a, CompressedBitmap const& b)
+            {return combine(a, b, XOR);}
+
+        bool operator==(CompressedBitmap const& rhs)const
+            {return combine(*this, rhs, XOR).isEmpty();}
+    };
+
+}
+
+#endif // COMPRESSEDBITMAP_H
@@ -0,0 +1,482 @@
+#ifndef COMPRESSEDSPARSE_H
+#define COMPRESSEDSPARSE_H
+
+#include "utils.hpp"
+#include "vector.hpp"
+#include "parallel.hpp"
+#include "sparse.hpp"
+#include <cassert>
+#include <cmath>
+#include <type_traits>
+#include <limits>
+#include <stdexcept>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace dmk{
+
+// sum of values[i] * x[indices[i]], with AVX2 gathers for double and float
+template<typename ITEM>
+ITEM gatherDot(ITEM const* values, int const* indices, int n, ITEM const* x){
+    ITEM sum = 0;
+    int i = 0;
+#ifdef __AVX2__
+    if constexpr(std::is_same<ITEM, double>::value){
+        __m256d lanes = _mm256_setzero_pd();
+        for(; i + 4 <= n; i += 4) lanes = _mm256_add_pd(lanes, _mm256_mul_pd(
+            _mm256_loadu_pd(values + i), _mm256_i32gather_pd(x,
+            _mm_loadu_si128((__m128i const*)(indices + i)), 8)));
+        __m128d half = _mm_add_pd(_mm256_castpd256_pd128(lanes), _mm256_extractf128_pd(lanes, 1));
+        sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+    }
+    else if constexpr(std::is_same<ITEM, float>::value){
+        __m256 lanes = _mm256_setzero_ps();
+        for(; i + 8 <= n; i += 8) lanes = _mm256_add_ps(lanes, _mm256_mul_ps(
+            _mm256_loadu_ps(values + i), _mm256_i32gather_ps(x,
+            _mm256_loadu_si256((__m256i const*)(indices + i)), 4)));
+        __m128 half = _mm_add_ps(_mm256_castps256_ps128(lanes), _mm256_extractf128_ps(lanes, 1));
+        half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        sum = _mm_cvtss_f32(_mm_add_ss(half, _mm_shuffle_ps(half, half, 1)));
+    }
+#endif
+    for(; i < n; ++i) sum += values[i] * x[indices[i]];
+    return sum;
+}
+
+// Immutable sparse matrix in compressed sparse column form, three flat
+// arrays: where each column starts in the other two, and the row and the
+// value of every item, by column and then row. Building and freeing cost
+// three allocations whatever the size. The compressed rows of a matrix
+// are the compressed columns of its transpose, so A x, which scatters
+// over the columns, is the gathering multiplyTransposed of the rows,
+// which is the one that runs in parallel.
+template<typename ITEM = double>
+class CompressedSparseMatrix{
+public:
+    typedef std::pair<int, ITEM> Item;
+
+    // the items of a column, read in place
+    class Column{
+        int const* rows;
+        ITEM const* values;
+        int size;
+    public:
+        Column(int const* theRows, ITEM const* theValues, int theSize):
+            rows(theRows), values(theValues), size(theSize) {}
+        int getSize()const{return size;}
+        Item operator[](int i)const{
+            assert(i >= 0 && i < size);
+            return Item(rows[i], values[i]);
+        }
+        int const* getRows()const{return rows;}
+        ITEM const* getValues()const{return values;}
+    };
+private:
+    int rows;
+    Vector<int> starts, rowIndices;
+    Vector<ITEM> values;
+
+    // columns [first, last) of a * b, appended to the arrays
+    static void productColumns(CompressedSparseMatrix const& a, CompressedSparseMatrix const& b,
+        int first, int last, Vector<int>& counts, Vector<int>& rows, Vector<ITEM>& values){
+        SparseAccumulator<ITEM> accumulator(a.rows);
+        for(int j = first; j < last; ++j){
+            int size = rows.getSize();
+            long long products = b.countProducts(a, j);
+            if(products > 0){
+                accumulator.start(products);
+                for(int i = b.starts[j]; i < b.starts[j + 1]; ++i){
+                    int k = b.rowIndices[i];
+                    for(int t = a.starts[k]; t < a.starts[k + 1]; ++t)
+                        accumulator.add(a.rowIndices[t], a.values[t] * b.values[i]);
+                }
+                int need = size + accumulator.getSize();
+                if(rows.getCapacity() < need){
+                    rows.reserve(std::max(need, 2 * rows.getCapacity()));
+                    values.reserve(rows.getCapacity());
+                }
+                accumulator.extract([&](int row, ITEM const& sum){
+                    rows.append(row);
+                    values.append(sum);
+                });
+            }
+            counts.append(rows.getSize() - size);
+        }
+    }
+    enum{MIN_PARALLEL_WORK = 1 << 15};
+    // first column c with starts[c] + c at least work
+    int workBound(long long work)const{
+        int low = 0, high = getColumns();
+        while(low < high){
+            int middle = low + (high - low) / 2;
+            if((long long)starts[middle] + middle < work) low = middle + 1;
+            else high = middle;
+        }
+        return low;
+    }
+    long long countProducts(CompressedSparseMatrix const& a, int j)const{
+        long long result = 0;
+        for(int i = starts[j]; i < starts[j + 1]; ++i)
+            result += a.starts[rowIndices[i] + 1] - a.starts[rowIndices[i]];
+        return result;
+    }
+public:
+    // takes over the arrays, items of each column in order of row
+    CompressedSparseMatrix(int theRows, Vector<int>&& theStarts,
+        Vector<int>&& theRowIndices, Vector<ITEM>&& theValues): rows(theRows),
+        starts(std::move(theStarts)), rowIndices(std::move(theRowIndices)),
+        values(std::move(theValues)){
+        assert(starts.getSize() > 0 && starts[0] == 0 &&
+            starts.lastItem() == rowIndices.getSize() && rowIndices.getSize() == values.getSize());
+    }
+
+    explicit CompressedSparseMatrix(SparseMatrix<ITEM> const& a): rows(a.getRows()),
+        starts(a.getColumns() + 1, 0){
+        for(int c = 0; c < a.getColumns(); ++c)
+            starts[c + 1] = starts[c] + a.getColumn(c).getSize();
+        rowIndices = Vector<int>(starts.lastItem());
+        values = Vector<ITEM>(starts.lastItem());
+        for(int c = 0; c < a.getColumns(); ++c){
+            typename SparseMatrix<ITEM>::SparseVector const& column = a.getColumn(c);
+            for(int j = 0; j < column.getSize(); ++j){
+                rowIndices[starts[c] + j] = column[j].first;
+                values[starts[c] + j] = column[j].second;
+            }
+        }
+    }
+
+    SparseMatrix<ITEM> toSparseMatrix()const{
+        SparseMatrix<ITEM> result(rows, getColumns());
+        for(int c = 0; c < getColumns(); ++c){
+            typename SparseMatrix<ITEM>::SparseVector column;
+            column.reserve(starts[c + 1] - starts[c]);
+            for(int i = starts[c]; i < starts[c + 1]; ++i)
+                column.append(Item(rowIndices[i], values[i]));
+            result.setColumn(c, std::move(column));
+        }
+        return result;
+    }
+
+    int getRows()const{return rows;}
+    int getColumns()const{return starts.getSize() - 1;}
+    int getNonzeroCount()const{return rowIndices.getSize();}
+
+    int const* getStarts()const{return starts.getArray();}
+    int const* getRowIndices()const{return rowIndices.getArray();}
+    ITEM const* getValues()const{return values.getArray();}
+
+    Column getColumn(int c)const{
+        assert(c >= 0 && c < getColumns());
+        return Column(rowIndices.getArray() + starts[c], values.getArray() + starts[c],
+            starts[c + 1] - starts[c]);
+    }
+
+    ITEM operator()(int r, int c)const
+    { //absent entries are 0
+        assert(0 <= r && r < rows && 0 <= c && c < getColumns());
+        int const *first = rowIndices.getArray() + starts[c],
+            *last = rowIndices.getArray() + starts[c + 1], *i = std::lower_bound(first, last, r);
+        return i != last && *i == r ? values[int(i - rowIndices.getArray())] : ITEM(0);
+    }
+
+    // counting sort of the items by row, which keeps them by column
+    CompressedSparseMatrix transpose()const{
+        Vector<int> resultStarts(rows + 1, 0), resultRows(getNonzeroCount());
+        Vector<ITEM> resultValues(getNonzeroCount());
+        for(int i = 0; i < getNonzeroCount(); ++i) ++resultStarts[rowIndices[i] + 1];
+        for(int r = 0; r < rows; ++r) resultStarts[r + 1] += resultStarts[r];
+        Vector<int> next(resultStarts);
+        for(int c = 0; c < getColumns(); ++c)
+            for(int i = starts[c]; i < starts[c + 1]; ++i){
+                int j = next[rowIndices[i]]++;
+                resultRows[j] = c;
+                resultValues[j] = values[i];
+            }
+        return CompressedSparseMatrix(getColumns(), std::move(resultStarts),
+            std::move(resultRows), std::move(resultValues));
+    }
+
+    friend double normInf(CompressedSparseMatrix const& A){
+        Vector<double> rowSums(A.rows, 0);
+        for(int i = 0; i < A.getNonzeroCount(); ++i)
+            rowSums[A.rowIndices[i]] += std::abs(A.values[i]);
+        double maxRowSum = 0;
+        for(int r = 0; r < A.rows; ++r) maxRowSum = std::max(maxRowSum, rowSums[r]);
+        return maxRowSum;
+    }
+
+    // y = A x, the columns scaled by the items of x
+    void multiply(ITEM const* x, ITEM* y)const{
+        for(int r = 0; r < rows; ++r) y[r] = 0;
+        for(int c = 0; c < getColumns(); ++c){
+            ITEM xc = x[c];
+            if(xc != 0) for(int i = starts[c]; i < starts[c + 1]; ++i)
+                y[rowIndices[i]] += values[i] * xc;
+        }
+    }
+
+    // y = A' x, the dot products of x with the columns
+    void multiplyTransposed(ITEM const* x, ITEM* y)const{
+        multiplyTransposed(x, y, 0, getColumns());
+    }
+    void multiplyTransposed(ITEM const* x, ITEM* y, int first, int last)const{
+        for(int c = first; c < last; ++c) y[c] = gatherDot(values.getArray() + starts[c],
+            rowIndices.getArray() + starts[c], starts[c + 1] - starts[c], x);
+    }
+
+    // the same with a range of columns per thread, of about the same
+    // number of items and columns
+    void multiplyTransposed(ITEM const* x, ITEM* y, ThreadPool& pool)const{
+        int parts = pool.getThreadCount(), columns = getColumns();
+        long long work = (long long)getNonzeroCount() + columns;
+        if(parts == 1 || work < MIN_PARALLEL_WORK){
+            multiplyTransposed(x, y);
+            return;
+        }
+        parallelFor(pool, 0, parts, 1, [&](long long p, long long){
+            multiplyTransposed(x, y, workBound(work * p / parts),
+                workBound(work * (p + 1) / parts));
+        });
+    }
+
+    friend Vector<ITEM> operator*(CompressedSparseMatrix const& A, Vector<ITEM> const& v){
+        assert(v.getSize() == A.getColumns());
+        Vector<ITEM> result(A.rows);
+        A.multiply(v.getArray(), result.getArray());
+        return result;
+    }
+
+    friend Vector<ITEM> operator*(Vector<ITEM> const& v, CompressedSparseMatrix const& A){
+        assert(v.getSize() == A.rows);
+        Vector<ITEM> result(A.getColumns());
+        A.multiplyTransposed(v.getArray(), result.getArray());
+        return result;
+    }
+
+    // Gustavson's product as with SparseMatrix::multiply, written straight
+    // into the flat arrays
+    static CompressedSparseMatrix multiply(CompressedSparseMatrix const& a,
+        CompressedSparseMatrix const& b){
+        assert(a.getColumns() == b.rows);
+        Vector<int> counts, resultRows;
+        Vector<ITEM> resultValues;
+        productColumns(a, b, 0, b.getColumns(), counts, resultRows, resultValues);
+        Vector<int> resultStarts(b.getColumns() + 1, 0);
+        for(int j = 0; j < b.getColumns(); ++j) resultStarts[j + 1] = resultStarts[j] + counts[j];
+        return CompressedSparseMatrix(a.rows, std::move(resultStarts), std::move(resultRows),
+            std::move(resultValues));
+    }
+
+    // every thread makes a range of columns of about the same number of
+    // products, then the ranges are copied into place
+    static CompressedSparseMatrix multiply(CompressedSparseMatrix const& a,
+        CompressedSparseMatrix const& b, ThreadPool& pool){
+        assert(a.getColumns() == b.rows);
+        int columns = b.getColumns(), parts = pool.getThreadCount();
+        Vector<long long> work(columns + 1, 0);
+        for(int j = 0; j < columns; ++j) work[j + 1] = work[j] + b.countProducts(a, j);
+        Vector<int> bounds(parts + 1, columns);
+        bounds[0] = 0;
+        for(int p = 1, j = 0; p < parts; ++p){
+            while(j < columns && work[j] * parts < work[columns] * p) ++j;
+            bounds[p] = j;
+        }
+        Vector<Vector<int> > partCounts(parts), partRows(parts);
+        Vector<Vector<ITEM> > partValues(parts);
+        parallelFor(pool, 0, parts, 1, [&](long long p, long long){
+            productColumns(a, b, bounds[p], bounds[p + 1], partCounts[p], partRows[p],
+                partValues[p]);
+        });
+        Vector<int> resultStarts(columns + 1, 0), offsets(parts + 1, 0);
+        for(int p = 0; p < parts; ++p){
+            for(int j = bounds[p]; j < bounds[p + 1]; ++j)
+                resultStarts[j + 1] = resultStarts[j] + partCounts[p][j - bounds[p]];
+            offsets[p + 1] = offsets[p] + partRows[p].getSize();
+        }
+        Vector<int> resultRows(offsets[parts]);
+        Vector<ITEM> resultValues(offsets[parts]);
+        parallelFor(pool, 0, parts, 1, [&](long long p, long long){
+            for(int i = 0; i < partRows[p].getSize(); ++i){
+                resultRows[offsets[p] + i] = partRows[p][i];
+                resultValues[offsets[p] + i] = partValues[p][i];
+            }
+        });
+        return CompressedSparseMatrix(a.rows, std::move(resultStarts), std::move(resultRows),
+            std::move(resultValues));
+    }
+
+    friend CompressedSparseMatrix operator*(CompressedSparseMatrix const& a,
+        CompressedSparseMatrix const& b){return multiply(a, b);}
+};
+
+
+// Collects (row, column, value) triplets in any order, with repeats for
+// an item, and builds the matrix in O(nnz + rows + columns). Two stable
+// counting sorts, by row into scratch and then by column into the arrays
+// of the matrix, are a radix sort of (column, row) with a digit each, so
+// every column comes out sorted by row. Repeats are then adjacent, and
+// are summed and zeros dropped in place. Threads may add to lists of
+// their own. The parallel build splits the triplets into ranges with a
+// table of counts per range and key, so it uses fewer ranges than
+// threads when they would hold fewer triplets than keys, which bounds
+// the tables by the triplets.
+template<typename ITEM = double>
+class TripletBuilder{
+    typedef std::pair<int, ITEM> Item;
+    struct Triplet{
+        int row, column;
+        ITEM value;
+    };
+    int rows, columns;
+    Vector<Vector<Triplet> > lists;
+
+    // Stable counting sort by a key in [0, keys) of items visited in
+    // parts, visit(p, f) calls f(key, row, column, value) for the items of
+    // part p in order, place(j, row, column, value) puts one at j. Returns
+    // where the items of each key start. parts * keys must fit an int.
+    template<typename VISIT, typename PLACE, typename RUN>
+    static Vector<int> countingScatter(int parts, int keys, VISIT const& visit,
+        PLACE const& place, RUN const& run){
+        // where each part puts the items of each key
+        Vector<int> next(parts * keys, 0), starts(keys + 1, 0);
+        run(parts, [&](int p){
+            int* count = next.getArray() + p * keys;
+            visit(p, [count](int key, int, int, ITEM const&){++count[key];});
+        });
+        for(int k = 0, total = 0; k < keys; ++k){
+            for(int p = 0; p < parts; ++p){
+                int& count = next[p * keys + k];
+                int size = count;
+                count = total;
+                total += size;
+            }
+            starts[k + 1] = total;
+        }
+        run(parts, [&](int p){
+            int* position = next.getArray() + p * keys;
+            visit(p, [&](int key, int row, int column, ITEM const& value)
+                {place(position[key]++, row, column, value);});
+        });
+        return starts;
+    }
+
+    // ranges of keys of about the same number of items
+    static Vector<int> balance(Vector<int> const& starts, int parts){
+        int keys = starts.getSize() - 1;
+        Vector<int> bounds(parts + 1, keys);
+        bounds[0] = 0;
+        for(int p = 1, k = 0; p < parts; ++p){
+            while(k < keys && (long long)starts[k] * parts < (long long)starts[keys] * p) ++k;
+            bounds[p] = k;
+        }
+        return bounds;
+    }
+
+    // run(n, f) calls f(i) for i in [0, n)
+    template<typename RUN>
+    CompressedSparseMatrix<ITEM> assemble(int threads, RUN const& run)const{
+        long long size = getSize();
+        if(size > std::numeric_limits<int>::max())
+            throw std::length_error("TripletBuilder: too many triplets");
+        int total = int(size);
+        // at least keys triplets per part, so the tables hold at most total
+        auto partsFor = [&](int keys){return std::max(1, std::min(threads, total / std::max(keys, 1)));};
+        // by row, the rows are then implied by the ranges of rowStarts
+        int rowParts = partsFor(rows);
+        Vector<Item> byRow(total);
+        Vector<int> rowStarts = countingScatter(rowParts, rows, [&](int p, auto const& f){
+            long long first = (long long)total * p / rowParts,
+                last = (long long)total * (p + 1) / rowParts;
+            for(long long l = 0, offset = 0; l < lists.getSize() && offset < last;
+                offset += lists[l++].getSize()){
+                Vector<Triplet> const& list = lists[l];
+                int end = int(std::min<long long>(last - offset, list.getSize()));
+                for(int i = int(std::max<long long>(first - offset, 0)); i < end; ++i)
+                    f(list[i].row, list[i].row, list[i].column, list[i].value);
+            }
+        }, [&](int j, int, int column, ITEM const& value){byRow[j] = Item(column, value);}, run);
+        // by column, keeping the order by row
+        int columnParts = partsFor(columns);
+        Vector<int> rowBounds = balance(rowStarts, columnParts), rowIndices(total);
+        Vector<ITEM> values(total);
+        Vector<int> starts = countingScatter(columnParts, columns, [&](int p, auto const& f){
+            for(int r = rowBounds[p]; r < rowBounds[p + 1]; ++r)
+                for(int i = rowStarts[r]; i < rowStarts[r + 1]; ++i)
+                    f(byRow[i].first, r, byRow[i].first, byRow[i].second);
+        }, [&](int j, int row, int, ITEM const& value){
+            rowIndices[j] = row;
+            values[j] = value;
+        }, run);
+        byRow = Vector<Item>();
+        // sum repeats and drop zeros in ranges of columns
+        Vector<int> bounds = balance(starts, threads), kept(columns + 1, 0);
+        run(threads, [&](int p){
+            for(int c = bounds[p]; c < bounds[p + 1]; ++c){
+                int first = starts[c], last = starts[c + 1], w = first;
+                for(int i = first; i < last;){
+                    int row = rowIndices[i];
+                    ITEM sum = values[i++];
+                    while(i < last && rowIndices[i] == row) sum += values[i++];
+                    if(sum != 0){
+                        rowIndices[w] = row;
+                        values[w++] = sum;
+                    }
+                }
+                kept[c + 1] = w - first;
+            }
+        });
+        // close the gaps left by repeats and zeros
+        for(int c = 0; c < columns; ++c){
+            int from = starts[c], to = kept[c];
+            for(int i = 0; i < kept[c + 1]; ++i){
+                rowIndices[to + i] = rowIndices[from + i];
+                values[to + i] = values[from + i];
+            }
+            kept[c + 1] += to;
+        }
+        while(rowIndices.getSize() > kept[columns]){
+            rowIndices.removeLast();
+            values.removeLast();
+        }
+        return CompressedSparseMatrix<ITEM>(rows, std::move(kept), std::move(rowIndices),
+            std::move(values));
+    }
+public:
+    TripletBuilder(int theRows, int theColumns, int listCount = 1): rows(theRows),
+        columns(theColumns), lists(listCount) {}
+
+    int getRows()const{return rows;}
+    int getColumns()const{return columns;}
+    int getListCount()const{return lists.getSize();}
+    long long getSize()const{
+        long long result = 0;
+        for(int l = 0; l < lists.getSize(); ++l) result += lists[l].getSize();
+        return result;
+    }
+
+    void reserve(int n, int list = 0){lists[list].reserve(n);}
+
+    // a list is for one thread at a time
+    void add(int row, int column, ITEM const& value, int list = 0){
+        assert(0 <= row && row < rows && 0 <= column && column < columns);
+        lists[list].append(Triplet{row, column, value});
+    }
+
+    void clear(){for(int l = 0; l < lists.getSize(); ++l) lists[l] = Vector<Triplet>();}
+
+    CompressedSparseMatrix<ITEM> buildCompressed()const{
+        return assemble(1, [](int n, auto const& f){for(int i = 0; i < n; ++i) f(i);});
+    }
+    CompressedSparseMatrix<ITEM> buildCompressed(ThreadPool& pool)const{
+        return assemble(pool.getThreadCount(), [&pool](int n, auto const& f){
+            parallelFor(pool, 0, n, 1, [&f](long long i, long long){f(int(i));});
+        });
+    }
+
+    SparseMatrix<ITEM> build()const{return buildCompressed().toSparseMatrix();}
+    SparseMatrix<ITEM> build(ThreadPool& pool)const{return buildCompressed(pool).toSparseMatrix();}
+};
+}
+
+#endif // COMPRESSEDSPARSE_H
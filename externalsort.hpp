@@ -0,0 +1,310 @@
+#ifndef EXTERNALSORT_H
+#define EXTERNALSORT_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include "utils.hpp"
+#include "vector.hpp"
+#include "sorting.hpp"
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define DMK_POSIX_FILES
+#endif
+
+namespace dmk{
+
+    // Tournament over k sources where every internal node keeps the loser
+    // of its match, so replacing the winner replays only its path, lg k
+    // comparisons. Exhausted sources lose to everything, ties go to the
+    // lower source to keep merges stable.
+    template<typename ITEM, typename COMPARATOR = DefaultComparator<ITEM> >
+    class LoserTree{
+        COMPARATOR c;
+        int k;
+        Vector<int> tree; // tree[0] is the winner, leaf i is node k + i
+        Vector<ITEM> items;
+        Vector<bool> done;
+
+        bool beats(int a, int b)const{
+            if(done[a] != done[b]) return done[b];
+            if(done[a]) return a < b;
+            return c(items[a], items[b]) || (!c(items[b], items[a]) && a < b);
+        }
+        int build(int node){
+            if(node >= k) return node - k;
+            int left = build(2 * node), right = build(2 * node + 1);
+            if(beats(left, right)){
+                tree[node] = right;
+                return left;
+            }
+            tree[node] = left;
+            return right;
+        }
+        void replay(int source){
+            for(int node = (source + k) / 2; node > 0; node /= 2)
+                if(beats(tree[node], source)) std::swap(tree[node], source);
+            tree[0] = source;
+        }
+    public:
+        // first items of all sources, exhausted ones are marked done
+        LoserTree(Vector<ITEM> const& firstItems, Vector<bool> const& isDone,
+            COMPARATOR const& theC = COMPARATOR()): c(theC),
+            k(firstItems.getSize()), tree(std::max(k, 1), 0), items(firstItems),
+            done(isDone){
+            assert(k > 0 && done.getSize() == k);
+            tree[0] = build(1);
+        }
+
+        bool isEmpty()const{return done[tree[0]];}
+        int winner()const{return tree[0];}
+        ITEM const& top()const{
+            assert(!isEmpty());
+            return items[tree[0]];
+        }
+        // the winning source continues with item or is exhausted
+        void replaceTop(ITEM const& item){
+            items[tree[0]] = item;
+            replay(tree[0]);
+        }
+        void removeTop(){
+            done[tree[0]] = true;
+            replay(tree[0]);
+        }
+    };
+
+    // Sorts more items than fit in memory. Items are appended, sorted in
+    // memory with pdqSort in runs as large as the budget allows, and the
+    // runs appended to one unlinked temporary file, so a single descriptor
+    // is open however many runs there are. finish() then merges the runs
+    // with a loser tree, first in several passes if there are too many to
+    // read from at once with blocks of at least MIN_BLOCK_BYTES, and the
+    // sorted items are read with next() or an iterator. Merged runs go to
+    // the end of the file, whose space is freed only when it is closed. If
+    // everything fits, nothing is written. Items are copied as bytes. Not
+    // stable.
+    template<typename ITEM, typename COMPARATOR = DefaultComparator<ITEM> >
+    class ExternalSorter{
+        static_assert(std::is_trivially_copyable<ITEM>::value, "items are written as bytes");
+        enum{MIN_BLOCK_BYTES = 1 << 20};
+        // in items of the file
+        struct Run{
+            long long offset, size;
+        };
+        // reads a run in large blocks
+        struct RunReader{
+            FILE* file;
+            Run run;
+            Vector<ITEM> block;
+            int position, blockSize;
+            long long read;
+            bool next(ITEM& item){
+                if(position == blockSize){
+                    if(read == run.size) return false;
+                    blockSize = int(std::min<long long>(block.getSize(), run.size - read));
+                    readItems(file, run.offset + read, block.getArray(), blockSize);
+                    read += blockSize;
+                    position = 0;
+                }
+                item = block[position++];
+                return true;
+            }
+        };
+        COMPARATOR c;
+        std::size_t memoryBudget;
+        std::string directory;
+        Vector<ITEM> buffer;
+        int bufferCapacity, memoryPosition;
+        long long size;
+        FILE* file; // of all runs, created by the first spill
+        long long fileSize;
+        Vector<Run> runs;
+        Vector<RunReader> readers;
+        LoserTree<ITEM, COMPARATOR>* tree;
+        bool finished;
+        ExternalSorter(ExternalSorter const&);
+        ExternalSorter& operator=(ExternalSorter const&);
+
+        // readers and the writer share the file, so all go to their position
+        static void seek(FILE* file, long long item){
+#ifdef DMK_POSIX_FILES
+            bool failed = fseeko(file, off_t(item * sizeof(ITEM)), SEEK_SET) != 0;
+#else
+            bool failed = std::fseek(file, long(item * sizeof(ITEM)), SEEK_SET) != 0;
+#endif
+            if(failed) throw std::runtime_error("external sort: run seek failed");
+        }
+        static void readItems(FILE* file, long long offset, ITEM* items, int n){
+            seek(file, offset);
+            if(std::fread((void*)items, sizeof(ITEM), n, file) != std::size_t(n))
+                throw std::runtime_error("external sort: run read failed");
+        }
+        // at the end of the file
+        void writeItems(ITEM const* items, int n){
+            seek(file, fileSize);
+            if(std::fwrite((void const*)items, sizeof(ITEM), n, file) != std::size_t(n))
+                throw std::runtime_error("external sort: run write failed");
+            fileSize += n;
+        }
+
+        FILE* temporaryFile(){
+#ifdef DMK_POSIX_FILES
+            // unlinked at once, the space is freed when the file is closed
+            std::string path = directory + "/dmk-sort-XXXXXX";
+            int descriptor = mkstemp(&path[0]);
+            FILE* result = descriptor == -1 ? nullptr : fdopen(descriptor, "w+b");
+            if(result) unlink(path.c_str());
+#else
+            FILE* result = std::tmpfile();
+#endif
+            if(!result) throw std::runtime_error("external sort: can't create a file in " + directory);
+            return result;
+        }
+
+        void spill(){
+            pdqSort(buffer.getArray(), 0, buffer.getSize() - 1, c);
+            if(!file) file = temporaryFile();
+            Run run = {fileSize, buffer.getSize()};
+            writeItems(buffer.getArray(), buffer.getSize());
+            runs.append(run);
+            buffer.removeAll();
+        }
+
+        // readers for runs [first, first + count) with equal blocks
+        void openReaders(int first, int count, int blockItems){
+            readers = Vector<RunReader>();
+            Vector<ITEM> firstItems;
+            Vector<bool> done;
+            for(int i = 0; i < count; ++i){
+                RunReader reader = {file, runs[first + i], Vector<ITEM>(blockItems, ITEM()),
+                    0, 0, 0};
+                readers.append(std::move(reader));
+                firstItems.append(ITEM());
+                done.append(!readers.lastItem().next(firstItems.lastItem()));
+            }
+            delete tree;
+            tree = new LoserTree<ITEM, COMPARATOR>(firstItems, done, c);
+        }
+
+        bool nextMerged(ITEM& item){
+            if(tree->isEmpty()) return false;
+            item = tree->top();
+            ITEM following;
+            if(readers[tree->winner()].next(following)) tree->replaceTop(following);
+            else tree->removeTop();
+            return true;
+        }
+
+    public:
+        ExternalSorter(std::size_t theMemoryBudget = 1 << 28,
+            COMPARATOR const& theC = COMPARATOR(),
+            std::string const& theDirectory = defaultDirectory()): c(theC),
+            memoryBudget(std::max<std::size_t>(theMemoryBudget, 4 * MIN_BLOCK_BYTES)),
+            directory(theDirectory), memoryPosition(0), size(0), file(nullptr), fileSize(0),
+            tree(nullptr), finished(false){
+            bufferCapacity = int(std::min<std::size_t>(memoryBudget / sizeof(ITEM),
+                std::numeric_limits<int>::max()));
+        }
+
+        static std::string defaultDirectory(){
+            char const* result = std::getenv("TMPDIR");
+            return result ? result : "/tmp";
+        }
+
+        void append(ITEM const& item){
+            assert(!finished);
+            // exactly the budget, doubling could overshoot it by up to 2x
+            if(size == 0) buffer.reserve(bufferCapacity);
+            if(buffer.getSize() == bufferCapacity) spill();
+            buffer.append(item);
+            ++size;
+        }
+
+        void finish(){
+            assert(!finished);
+            finished = true;
+            if(runs.getSize() == 0){ // everything fit
+                pdqSort(buffer.getArray(), 0, buffer.getSize() - 1, c);
+                return;
+            }
+            if(buffer.getSize() > 0) spill();
+            buffer = Vector<ITEM>();
+#ifdef DMK_POSIX_FILES
+            // let the kernel read ahead aggressively
+            posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+            // merge passes until the runs can share the budget, the first
+            // merges just enough runs that all later ones merge fanIn, so
+            // no pass rewrites items only to save a run
+            int fanIn = int(std::max<std::size_t>(2, memoryBudget / MIN_BLOCK_BYTES - 1));
+            for(int count = (runs.getSize() - 1) % (fanIn - 1) + 1; runs.getSize() > fanIn;
+                count = fanIn){
+                if(count == 1) continue; // already full passes
+                int blockItems = std::max<int>(1, memoryBudget / (fanIn + 1) / sizeof(ITEM));
+                openReaders(0, count, blockItems);
+                Run merged = {fileSize, 0};
+                Vector<ITEM> output(blockItems, ITEM());
+                int outputSize = 0;
+                for(ITEM item; nextMerged(item);){
+                    output[outputSize++] = item;
+                    if(outputSize == blockItems){
+                        writeItems(output.getArray(), outputSize);
+                        outputSize = 0;
+                    }
+                    ++merged.size;
+                }
+                writeItems(output.getArray(), outputSize);
+                Vector<Run> remaining;
+                for(int i = count; i < runs.getSize(); ++i) remaining.append(runs[i]);
+                remaining.append(merged);
+                runs = remaining;
+            }
+            openReaders(0, runs.getSize(),
+                std::max<int>(1, memoryBudget / runs.getSize() / sizeof(ITEM)));
+        }
+
+        long long getSize()const{return size;}
+        int getRunCount()const{return runs.getSize();}
+
+        // sorted items one at a time after finish
+        bool next(ITEM& item){
+            assert(finished);
+            if(runs.getSize() > 0) return nextMerged(item);
+            if(memoryPosition == buffer.getSize()) return false;
+            item = buffer[memoryPosition++];
+            return true;
+        }
+
+        class Iterator{
+            ExternalSorter* sorter; // null at the end
+            ITEM item;
+            void advance(){if(!sorter->next(item)) sorter = nullptr;}
+        public:
+            Iterator(ExternalSorter* theSorter): sorter(theSorter)
+                {if(sorter) advance();}
+            ITEM const& operator*()const{return item;}
+            ITEM const* operator->()const{return &item;}
+            Iterator& operator++(){
+                advance();
+                return *this;
+            }
+            bool operator==(Iterator const& rhs)const{return sorter == rhs.sorter;}
+            bool operator!=(Iterator const& rhs)const{return sorter != rhs.sorter;}
+        };
+        // single pass, begin() starts reading
+        Iterator begin(){return Iterator(this);}
+        Iterator end(){return Iterator(nullptr);}
+
+        ~ExternalSorter(){
+            delete tree;
+            if(file) std::fclose(file);
+        }
+    };
+
+}
+
+#endif // EXTERNALSORT_H
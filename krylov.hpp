@@ -0,0 +1,457 @@
+#ifndef KRYLOV_H
+#define KRYLOV_H
+
+#include "utils.hpp"
+#include "vector.hpp"
+#include "parallel.hpp"
+#include "sparse.hpp"
+#include "compressedsparse.hpp"
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+namespace dmk{
+
+// A square matrix for the Krylov solvers, in compressed rows, which are
+// the compressed columns of A'. Products gather along the rows, on the
+// pool if given, and the preconditioners sweep over them. Rows are
+// sorted by column, so the items before the diagonal are the lower part.
+template<typename ITEM = double>
+class KrylovMatrix{
+    CompressedSparseMatrix<ITEM> compressedRows;
+    Vector<int> diagonals; // position of the diagonal item of every row, -1 if none
+    ThreadPool* pool;
+public:
+    explicit KrylovMatrix(SparseMatrix<ITEM> const& A, ThreadPool* thePool = 0):
+        compressedRows(CompressedSparseMatrix<ITEM>(A).transpose()),
+        diagonals(A.getRows(), -1), pool(thePool){
+        assert(A.getRows() == A.getColumns());
+        int const *starts = getStarts(), *columns = getColumnIndices();
+        for(int r = 0; r < getSize(); ++r)
+            for(int i = starts[r]; i < starts[r + 1]; ++i) if(columns[i] == r) diagonals[r] = i;
+    }
+
+    int getSize()const{return diagonals.getSize();}
+    int getNonzeroCount()const{return compressedRows.getNonzeroCount();}
+    int const* getStarts()const{return compressedRows.getStarts();}
+    int const* getColumnIndices()const{return compressedRows.getRowIndices();}
+    ITEM const* getValues()const{return compressedRows.getValues();}
+    int const* getDiagonals()const{return diagonals.getArray();}
+
+    // y = A x
+    void multiply(ITEM const* x, ITEM* y)const{
+        if(pool) compressedRows.multiplyTransposed(x, y, *pool);
+        else compressedRows.multiplyTransposed(x, y);
+    }
+};
+
+// Preconditioners solve M z = r for an approximation M of A, cheaply.
+// Those that sweep over A keep a reference to it.
+template<typename ITEM = double> struct IdentityPreconditioner{
+    void apply(ITEM const* r, ITEM* z, int n)const{for(int i = 0; i < n; ++i) z[i] = r[i];}
+};
+
+// M = D
+template<typename ITEM = double> class JacobiPreconditioner{
+    Vector<ITEM> inverseDiagonal;
+public:
+    explicit JacobiPreconditioner(KrylovMatrix<ITEM> const& A): inverseDiagonal(A.getSize()){
+        for(int r = 0; r < A.getSize(); ++r){
+            int d = A.getDiagonals()[r];
+            assert(d >= 0 && A.getValues()[d] != 0);
+            inverseDiagonal[r] = 1 / A.getValues()[d];
+        }
+    }
+    void apply(ITEM const* r, ITEM* z, int n)const
+        {for(int i = 0; i < n; ++i) z[i] = r[i] * inverseDiagonal[i];}
+};
+
+// M = (D + L) D^-1 (D + U), a forward and a backward Gauss-Seidel sweep
+// from zero, symmetric when A is, so it works with CG
+template<typename ITEM = double> class SymmetricGaussSeidelPreconditioner{
+    KrylovMatrix<ITEM> const& A;
+    Vector<ITEM> inverseDiagonal;
+public:
+    explicit SymmetricGaussSeidelPreconditioner(KrylovMatrix<ITEM> const& theA): A(theA),
+        inverseDiagonal(theA.getSize()){
+        for(int r = 0; r < A.getSize(); ++r){
+            int d = A.getDiagonals()[r];
+            assert(d >= 0 && A.getValues()[d] != 0);
+            inverseDiagonal[r] = 1 / A.getValues()[d];
+        }
+    }
+    void apply(ITEM const* r, ITEM* z, int n)const{
+        int const *starts = A.getStarts(), *columns = A.getColumnIndices(),
+            *diagonals = A.getDiagonals();
+        ITEM const* values = A.getValues();
+        for(int i = 0; i < n; ++i){
+            ITEM sum = r[i];
+            for(int j = starts[i]; j < diagonals[i]; ++j) sum -= values[j] * z[columns[j]];
+            z[i] = sum * inverseDiagonal[i];
+        }
+        for(int i = n - 1; i >= 0; --i){
+            ITEM sum = 0;
+            for(int j = diagonals[i] + 1; j < starts[i + 1]; ++j) sum += values[j] * z[columns[j]];
+            z[i] -= sum * inverseDiagonal[i];
+        }
+    }
+};
+
+// M = L U with the nonzero pattern of A and unit L, both stored in the
+// items of A, computed row by row as in Gaussian elimination with the
+// updates outside the pattern dropped
+template<typename ITEM = double> class ILU0Preconditioner{
+    KrylovMatrix<ITEM> const& A;
+    Vector<ITEM> factors, inverseDiagonal;
+public:
+    explicit ILU0Preconditioner(KrylovMatrix<ITEM> const& theA): A(theA),
+        factors(theA.getNonzeroCount()), inverseDiagonal(theA.getSize()){
+        int n = A.getSize();
+        int const *starts = A.getStarts(), *columns = A.getColumnIndices(),
+            *diagonals = A.getDiagonals();
+        for(int i = 0; i < A.getNonzeroCount(); ++i) factors[i] = A.getValues()[i];
+        Vector<int> positions(n, -1); // of the items of row i by column
+        for(int i = 0; i < n; ++i){
+            assert(diagonals[i] >= 0);
+            for(int j = starts[i]; j < starts[i + 1]; ++j) positions[columns[j]] = j;
+            for(int j = starts[i]; j < diagonals[i]; ++j){
+                int k = columns[j];
+                ITEM l = factors[j] *= inverseDiagonal[k];
+                for(int t = diagonals[k] + 1; t < starts[k + 1]; ++t){
+                    int p = positions[columns[t]];
+                    if(p >= 0) factors[p] -= l * factors[t];
+                }
+            }
+            for(int j = starts[i]; j < starts[i + 1]; ++j) positions[columns[j]] = -1;
+            assert(factors[diagonals[i]] != 0);
+            inverseDiagonal[i] = 1 / factors[diagonals[i]];
+        }
+    }
+    void apply(ITEM const* r, ITEM* z, int n)const{
+        int const *starts = A.getStarts(), *columns = A.getColumnIndices(),
+            *diagonals = A.getDiagonals();
+        for(int i = 0; i < n; ++i){
+            ITEM sum = r[i];
+            for(int j = starts[i]; j < diagonals[i]; ++j) sum -= factors[j] * z[columns[j]];
+            z[i] = sum;
+        }
+        for(int i = n - 1; i >= 0; --i){
+            ITEM sum = z[i];
+            for(int j = diagonals[i] + 1; j < starts[i + 1]; ++j) sum -= factors[j] * z[columns[j]];
+            z[i] = sum * inverseDiagonal[i];
+        }
+    }
+};
+
+// what a solve did, residuals are norms of b - A x relative to that of b
+struct KrylovStatistics{
+    bool converged;
+    int iterations, products, preconditionings;
+    double residual; // of the result, recomputed
+    double seconds, productSeconds, preconditionerSeconds;
+    Vector<double> residuals; // the initial one, then one per iteration
+    KrylovStatistics(): converged(false), iterations(0), products(0), preconditionings(0),
+        residual(0), seconds(0), productSeconds(0), preconditionerSeconds(0){}
+    double getSecondsPerIteration()const{return iterations ? seconds / iterations : 0;}
+};
+
+namespace krylov{
+    // Fused vector kernels, one pass over the items each, instead of the
+    // temporaries of the ArithmeticType operators of Vector
+
+    template<typename ITEM> double dot(ITEM const* a, ITEM const* b, int n){
+        double result = 0;
+        for(int i = 0; i < n; ++i) result += a[i] * b[i];
+        return result;
+    }
+
+    // y += a x
+    template<typename ITEM> void axpy(double a, ITEM const* x, ITEM* y, int n)
+        {for(int i = 0; i < n; ++i) y[i] += a * x[i];}
+
+    // r = b - r, returns r r
+    template<typename ITEM> double subtractFrom(ITEM const* b, ITEM* r, int n){
+        double result = 0;
+        for(int i = 0; i < n; ++i){
+            r[i] = b[i] - r[i];
+            result += r[i] * r[i];
+        }
+        return result;
+    }
+
+    // y -= a x, returns y y
+    template<typename ITEM> double subtractScaled(double a, ITEM const* x, ITEM* y, int n){
+        double result = 0;
+        for(int i = 0; i < n; ++i){
+            y[i] -= a * x[i];
+            result += y[i] * y[i];
+        }
+        return result;
+    }
+
+    // x += alpha p and r -= alpha q, returns r r
+    template<typename ITEM> double cgUpdate(double alpha, ITEM const* p, ITEM const* q,
+        ITEM* x, ITEM* r, int n){
+        double result = 0;
+        for(int i = 0; i < n; ++i){
+            x[i] += alpha * p[i];
+            r[i] -= alpha * q[i];
+            result += r[i] * r[i];
+        }
+        return result;
+    }
+
+    // p = z + beta p
+    template<typename ITEM> void xpay(ITEM const* z, double beta, ITEM* p, int n)
+        {for(int i = 0; i < n; ++i) p[i] = z[i] + beta * p[i];}
+
+    // p = r + beta (p - omega v)
+    template<typename ITEM> void bicgDirection(ITEM const* r, double beta, double omega,
+        ITEM const* v, ITEM* p, int n)
+        {for(int i = 0; i < n; ++i) p[i] = r[i] + beta * (p[i] - omega * v[i]);}
+
+    // x += alpha ph + omega sh and r -= omega t, returns r r
+    template<typename ITEM> double bicgUpdate(double alpha, ITEM const* ph, double omega,
+        ITEM const* sh, ITEM const* t, ITEM* x, ITEM* r, int n){
+        double result = 0;
+        for(int i = 0; i < n; ++i){
+            x[i] += alpha * ph[i] + omega * sh[i];
+            r[i] -= omega * t[i];
+            result += r[i] * r[i];
+        }
+        return result;
+    }
+
+    // t s and t t together
+    template<typename ITEM> void dot2(ITEM const* t, ITEM const* s, int n, double& ts, double& tt){
+        ts = tt = 0;
+        for(int i = 0; i < n; ++i){
+            ts += t[i] * s[i];
+            tt += t[i] * t[i];
+        }
+    }
+
+    // Counts and times the products and preconditionings of a solve and
+    // records its residuals
+    template<typename ITEM, typename PRECONDITIONER> class Solve{
+        typedef std::chrono::steady_clock Clock;
+        KrylovMatrix<ITEM> const& A;
+        PRECONDITIONER const& M;
+        Vector<ITEM> const& b;
+        double bNorm, tolerance;
+        Clock::time_point start;
+        static double since(Clock::time_point t)
+            {return std::chrono::duration<double>(Clock::now() - t).count();}
+    public:
+        KrylovStatistics statistics;
+        int n;
+        Solve(KrylovMatrix<ITEM> const& theA, PRECONDITIONER const& theM,
+            Vector<ITEM> const& theB, Vector<ITEM>& x, double theTolerance): A(theA), M(theM),
+            b(theB), bNorm(std::sqrt(dot(theB.getArray(), theB.getArray(), theB.getSize()))),
+            tolerance(theTolerance), start(Clock::now()), n(theA.getSize()){
+            assert(b.getSize() == n && tolerance > 0);
+            if(x.getSize() != n || !(bNorm > 0)) x = Vector<ITEM>(n, 0);
+        }
+
+        void multiply(ITEM const* x, ITEM* y){
+            Clock::time_point t = Clock::now();
+            A.multiply(x, y);
+            statistics.productSeconds += since(t);
+            ++statistics.products;
+        }
+        void precondition(ITEM const* r, ITEM* z){
+            Clock::time_point t = Clock::now();
+            M.apply(r, z, n);
+            statistics.preconditionerSeconds += since(t);
+            ++statistics.preconditionings;
+        }
+        // r = b - A x, returns r r
+        double residual(ITEM const* x, ITEM* r){
+            multiply(x, r);
+            return subtractFrom(b.getArray(), r, n);
+        }
+        // true if rr, a squared residual norm, is small enough
+        bool isSmall(double rr)const{return !(bNorm > 0) || std::sqrt(rr) <= tolerance * bNorm;}
+        bool record(double rr){
+            statistics.residuals.append(bNorm > 0 ? std::sqrt(rr) / bNorm : 0);
+            return isSmall(rr);
+        }
+        KrylovStatistics finish(Vector<ITEM> const& x, bool converged){
+            Vector<ITEM> r(n);
+            double rr = residual(x.getArray(), r.getArray());
+            statistics.residual = bNorm > 0 ? std::sqrt(rr) / bNorm : 0;
+            statistics.converged = converged;
+            statistics.seconds = since(start);
+            return statistics;
+        }
+    };
+}
+
+// The solvers take x as the starting guess, zeros if it has the wrong
+// size or b is 0, and return with it when the residual is at most tolerance or
+// after maxIterations. Preconditioning is on the left for CG, which
+// needs a symmetric M, and on the right for the others, so that their
+// residuals are those of A x = b.
+
+// conjugate gradient, for symmetric positive definite A
+template<typename ITEM, typename PRECONDITIONER>
+KrylovStatistics conjugateGradient(KrylovMatrix<ITEM> const& A, Vector<ITEM> const& b,
+    Vector<ITEM>& x, PRECONDITIONER const& M, double tolerance = 1e-8, int maxIterations = 1000){
+    krylov::Solve<ITEM, PRECONDITIONER> solve(A, M, b, x, tolerance);
+    int n = solve.n;
+    Vector<ITEM> r(n), z(n), p(n), q(n);
+    bool converged = solve.record(solve.residual(x.getArray(), r.getArray()));
+    double rz = 0;
+    if(!converged){
+        solve.precondition(r.getArray(), z.getArray());
+        p = z;
+        rz = krylov::dot(r.getArray(), z.getArray(), n);
+    }
+    while(!converged && solve.statistics.iterations < maxIterations){
+        solve.multiply(p.getArray(), q.getArray());
+        double pq = krylov::dot(p.getArray(), q.getArray(), n);
+        if(pq == 0) break;
+        converged = solve.record(krylov::cgUpdate(rz / pq, p.getArray(), q.getArray(),
+            x.getArray(), r.getArray(), n));
+        ++solve.statistics.iterations;
+        if(converged) break;
+        solve.precondition(r.getArray(), z.getArray());
+        double next = krylov::dot(r.getArray(), z.getArray(), n);
+        krylov::xpay(z.getArray(), next / rz, p.getArray(), n);
+        rz = next;
+    }
+    return solve.finish(x, converged);
+}
+template<typename ITEM> KrylovStatistics conjugateGradient(KrylovMatrix<ITEM> const& A,
+    Vector<ITEM> const& b, Vector<ITEM>& x, double tolerance = 1e-8, int maxIterations = 1000){
+    return conjugateGradient(A, b, x, IdentityPreconditioner<ITEM>(), tolerance, maxIterations);
+}
+
+// BiCGSTAB, for general A, stops early if it breaks down, when a
+// denominator vanishes
+template<typename ITEM, typename PRECONDITIONER>
+KrylovStatistics biCGStab(KrylovMatrix<ITEM> const& A, Vector<ITEM> const& b,
+    Vector<ITEM>& x, PRECONDITIONER const& M, double tolerance = 1e-8, int maxIterations = 1000){
+    krylov::Solve<ITEM, PRECONDITIONER> solve(A, M, b, x, tolerance);
+    int n = solve.n;
+    Vector<ITEM> r(n), shadow, p(n, 0), v(n, 0), ph(n), sh(n), t(n);
+    bool converged = solve.record(solve.residual(x.getArray(), r.getArray()));
+    shadow = r;
+    double rho = 1, alpha = 1, omega = 1;
+    while(!converged && solve.statistics.iterations < maxIterations){
+        double next = krylov::dot(shadow.getArray(), r.getArray(), n);
+        if(next == 0) break;
+        krylov::bicgDirection(r.getArray(), next / rho * (alpha / omega), omega, v.getArray(),
+            p.getArray(), n);
+        rho = next;
+        solve.precondition(p.getArray(), ph.getArray());
+        solve.multiply(ph.getArray(), v.getArray());
+        double shadowV = krylov::dot(shadow.getArray(), v.getArray(), n);
+        if(shadowV == 0) break;
+        alpha = rho / shadowV;
+        // r is s from here on
+        double ss = krylov::subtractScaled(alpha, v.getArray(), r.getArray(), n);
+        ++solve.statistics.iterations;
+        if(solve.isSmall(ss)){
+            krylov::axpy(alpha, ph.getArray(), x.getArray(), n);
+            converged = solve.record(ss);
+            break;
+        }
+        solve.precondition(r.getArray(), sh.getArray());
+        solve.multiply(sh.getArray(), t.getArray());
+        double ts, tt;
+        krylov::dot2(t.getArray(), r.getArray(), n, ts, tt);
+        omega = tt > 0 ? ts / tt : 0;
+        converged = solve.record(krylov::bicgUpdate(alpha, ph.getArray(), omega, sh.getArray(),
+            t.getArray(), x.getArray(), r.getArray(), n));
+        if(omega == 0) break;
+    }
+    return solve.finish(x, converged);
+}
+template<typename ITEM> KrylovStatistics biCGStab(KrylovMatrix<ITEM> const& A,
+    Vector<ITEM> const& b, Vector<ITEM>& x, double tolerance = 1e-8, int maxIterations = 1000){
+    return biCGStab(A, b, x, IdentityPreconditioner<ITEM>(), tolerance, maxIterations);
+}
+
+// GMRES restarted every restart iterations, for general A. Arnoldi with
+// modified Gram-Schmidt builds the basis, and Givens rotations keep the
+// Hessenberg matrix triangular, which gives the residual of every
+// iteration without forming x. Memory is restart + 1 vectors.
+template<typename ITEM, typename PRECONDITIONER>
+KrylovStatistics gmres(KrylovMatrix<ITEM> const& A, Vector<ITEM> const& b, Vector<ITEM>& x,
+    PRECONDITIONER const& M, double tolerance = 1e-8, int maxIterations = 1000, int restart = 30){
+    assert(restart > 0);
+    krylov::Solve<ITEM, PRECONDITIONER> solve(A, M, b, x, tolerance);
+    int n = solve.n, m = restart;
+    // the basis, and the Hessenberg matrix by column
+    Vector<ITEM> basis((m + 1) * n), z(n), u(n);
+    Vector<double> h((m + 1) * m), cosines(m), sines(m), g(m + 1), y(m);
+    auto vector = [&](int j){return basis.getArray() + (long long)j * n;};
+    double rr = solve.residual(x.getArray(), vector(0));
+    bool converged = solve.record(rr);
+    while(!converged && solve.statistics.iterations < maxIterations){
+        double beta = std::sqrt(rr);
+        for(int i = 0; i < n; ++i) vector(0)[i] /= beta;
+        for(int i = 0; i <= m; ++i) g[i] = 0;
+        g[0] = beta;
+        int k = 0; // columns of this cycle
+        bool breakdown = false;
+        while(k < m && solve.statistics.iterations < maxIterations){
+            double* column = h.getArray() + k * (m + 1);
+            ITEM* w = vector(k + 1);
+            solve.precondition(vector(k), z.getArray());
+            solve.multiply(z.getArray(), w);
+            for(int i = 0; i <= k; ++i){
+                column[i] = krylov::dot(w, vector(i), n);
+                krylov::axpy(-column[i], vector(i), w, n);
+            }
+            double norm = std::sqrt(krylov::dot(w, w, n));
+            column[k + 1] = norm;
+            if(norm > 0) for(int i = 0; i < n; ++i) w[i] /= norm;
+            else breakdown = true;
+            for(int i = 0; i < k; ++i){
+                double t = cosines[i] * column[i] + sines[i] * column[i + 1];
+                column[i + 1] = cosines[i] * column[i + 1] - sines[i] * column[i];
+                column[i] = t;
+            }
+            double d = std::hypot(column[k], column[k + 1]);
+            cosines[k] = d > 0 ? column[k] / d : 1;
+            sines[k] = d > 0 ? column[k + 1] / d : 0;
+            column[k] = d;
+            column[k + 1] = 0;
+            g[k + 1] = -sines[k] * g[k];
+            g[k] *= cosines[k];
+            ++k;
+            ++solve.statistics.iterations;
+            if(solve.record(g[k] * g[k]) || breakdown) break;
+        }
+        // x += M^-1 V y for the triangular H y = g
+        for(int i = k - 1; i >= 0; --i){
+            double sum = g[i];
+            for(int j = i + 1; j < k; ++j) sum -= h[j * (m + 1) + i] * y[j];
+            y[i] = h[i * (m + 1) + i] != 0 ? sum / h[i * (m + 1) + i] : 0;
+        }
+        for(int i = 0; i < n; ++i){
+            double sum = 0;
+            for(int j = 0; j < k; ++j) sum += y[j] * vector(j)[i];
+            u[i] = sum;
+        }
+        solve.precondition(u.getArray(), z.getArray());
+        krylov::axpy(1.0, z.getArray(), x.getArray(), n);
+        // the estimate drifts, the true residual replaces it and restarts
+        rr = solve.residual(x.getArray(), vector(0));
+        solve.statistics.residuals.removeLast();
+        converged = solve.record(rr);
+        if(breakdown || rr == 0) break;
+    }
+    return solve.finish(x, converged);
+}
+template<typename ITEM> KrylovStatistics gmres(KrylovMatrix<ITEM> const& A,
+    Vector<ITEM> const& b, Vector<ITEM>& x, double tolerance = 1e-8, int maxIterations = 1000,
+    int restart = 30){
+    return gmres(A, b, x, IdentityPreconditioner<ITEM>(), tolerance, maxIterations, restart);
+}
+
+}
+
+#endif // KRYLOV_H
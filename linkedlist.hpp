@@ -2,9 +2,10 @@
 #define LINKEDLIST_H
 
 #include "utils.hpp"
+#include "allocator.hpp"
 
 namespace dmk{
-	template<typename ITEM>
+	template<typename ITEM, typename ALLOCATOR = DefaultAllocator>
     class SimpleDoublyLinkedList{
         struct Node {
             ITEM item;
@@ -12,15 +13,21 @@ namespace dmk{
             template<typename ARGUMENT>
             Node(ARGUMENT const& a): item(a), next(nullptr), prev(nullptr) {}
         } *root, *last;
+        [[no_unique_address]] ALLOCATOR allocator;
+        void deleteNode(Node* n){
+            n->~Node();
+            allocator.deallocate(n, sizeof(Node));
+        }
         void cut(Node* n){
             assert(n);
             (n == last ? last : n->next->prev) = n->prev;
             (n == root ? root : n->prev->next) = n->next;
         }
     public:
-        SimpleDoublyLinkedList(): root(nullptr), last(nullptr) {}
+        SimpleDoublyLinkedList(ALLOCATOR const& theAllocator = ALLOCATOR()):
+            root(nullptr), last(nullptr), allocator(theAllocator) {}
         template<typename ARGUMENT> void append(ARGUMENT const& a){
-            Node* n = new Node(a);
+            Node* n = new(allocator.allocate(sizeof(Node)))Node(a);
             n->prev = last;
             if(last) last->next = n;
             last = n;
@@ -75,10 +82,11 @@ namespace dmk{
         void remove(Iterator what){
             assert(what != end());
             cut(what.getHandle());
-            delete what.getHandle();
+            deleteNode(what.getHandle());
         }
 
-        SimpleDoublyLinkedList(SimpleDoublyLinkedList const& rhs){
+        SimpleDoublyLinkedList(SimpleDoublyLinkedList const& rhs):
+            root(nullptr), last(nullptr), allocator(rhs.allocator){
             for(Node* n = rhs.root; n; n = n->next){append(n->item);}
         }
         SimpleDoublyLinkedList& operator=(SimpleDoublyLinkedList const& rhs){
@@ -88,7 +96,7 @@ namespace dmk{
             while(root){
                 Node* toBeDeleted = root;
                 root = root->next;
-                delete toBeDeleted;
+                deleteNode(toBeDeleted);
             }
         }
 	};
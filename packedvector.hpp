@@ -0,0 +1,125 @@
+#ifndef PACKEDVECTOR_H
+#define PACKEDVECTOR_H
+
+#include <utility>
+#include "utils.hpp"
+#include "vector.hpp"
+
+namespace dmk{
+
+    // Unsigned values of BITS bits each, stored back to back in 64 bit
+    // words, so a value straddles at most two words. Random access does
+    // two loads and shifts; bulk decode/encode work on blocks of 64
+    // values, which fill exactly BITS words, with all shifts unrolled at
+    // compile time. Widths dividing 64 never straddle.
+    template<int BITS> class PackedVector{
+        static_assert(BITS > 0 && BITS <= 64, "1 to 64 bits per item");
+        enum{BLOCK = 64};
+        static constexpr unsigned long long MASK =
+            BITS == 64 ? ~0ull : (1ull << (BITS % 64)) - 1;
+        long long size;
+        Vector<unsigned long long> words; // with a padding word at the end
+
+        void growWords(){
+            while(words.getSize() < ceiling(size * BITS, 64) + 1) words.append(0);
+        }
+
+        template<int J, typename OUT>
+        static void unpack(unsigned long long const* in, OUT* out){
+            constexpr int bit = J * BITS, w = bit / 64, offset = bit % 64;
+            unsigned long long value = in[w] >> offset;
+            if constexpr(offset + BITS > 64) value |= in[w + 1] << (64 - offset);
+            out[J] = OUT(value & MASK);
+        }
+        template<typename OUT, std::size_t... J> static void unpackBlock(
+            unsigned long long const* in, OUT* out, std::index_sequence<J...>)
+            {(unpack<J>(in, out), ...);}
+
+        template<int J, typename IN>
+        static void pack(IN const* in, unsigned long long* out){
+            constexpr int bit = J * BITS, w = bit / 64, offset = bit % 64;
+            unsigned long long value = (unsigned long long)in[J] & MASK;
+            if constexpr(offset == 0) out[w] = value;
+            else out[w] |= value << offset;
+            if constexpr(offset + BITS > 64) out[w + 1] = value >> (64 - offset);
+        }
+        template<typename IN, std::size_t... J> static void packBlock(
+            IN const* in, unsigned long long* out, std::index_sequence<J...>)
+            {(pack<J>(in, out), ...);}
+    public:
+        PackedVector(): size(0), words(1, 0) {}
+        explicit PackedVector(long long initialSize, unsigned long long value = 0):
+            size(0), words(1, 0){
+            for(long long i = 0; i < initialSize; ++i) append(value);
+        }
+
+        long long getSize()const{return size;}
+        Vector<unsigned long long> const& getStorage()const{return words;}
+
+        unsigned long long operator[](long long i)const{
+            assert(i >= 0 && i < size);
+            unsigned long long bit = (unsigned long long)i * BITS;
+            unsigned long long const* w = words.getArray() + bit / 64;
+            unsigned offset = bit % 64;
+            // the double shift is 0 for offset 0, no branch on straddling
+            return ((w[0] >> offset) | (w[1] << 1 << (63 - offset))) & MASK;
+        }
+
+        void set(long long i, unsigned long long value){
+            assert(i >= 0 && i < size);
+            unsigned long long bit = (unsigned long long)i * BITS;
+            unsigned long long* w = words.getArray() + bit / 64;
+            unsigned offset = bit % 64;
+            value &= MASK;
+            w[0] = (w[0] & ~(MASK << offset)) | (value << offset);
+            if(offset + BITS > 64){
+                int spill = 64 - offset;
+                w[1] = (w[1] & ~(MASK >> spill)) | (value >> spill);
+            }
+        }
+
+        void append(unsigned long long value){
+            ++size;
+            growWords();
+            set(size - 1, value);
+        }
+
+        void removeLast(){
+            assert(size > 0);
+            set(size - 1, 0); // keep unused bits zero
+            --size;
+        }
+
+        // out[j] = item first + j for j < n
+        template<typename OUT> void decode(long long first, long long n, OUT* out)const{
+            assert(first >= 0 && n >= 0 && first + n <= size);
+            long long i = first, end = first + n;
+            for(; i < end && i % BLOCK; ++i) *out++ = OUT((*this)[i]);
+            for(; i + BLOCK <= end; i += BLOCK, out += BLOCK)
+                unpackBlock(words.getArray() + i / BLOCK * BITS, out,
+                    std::make_index_sequence<BLOCK>());
+            for(; i < end; ++i) *out++ = OUT((*this)[i]);
+        }
+
+        // item first + j = in[j] for j < n, overwriting
+        template<typename IN> void encode(long long first, long long n, IN const* in){
+            assert(first >= 0 && n >= 0 && first + n <= size);
+            long long i = first, end = first + n;
+            for(; i < end && i % BLOCK; ++i) set(i, *in++);
+            for(; i + BLOCK <= end; i += BLOCK, in += BLOCK)
+                packBlock(in, words.getArray() + i / BLOCK * BITS,
+                    std::make_index_sequence<BLOCK>());
+            for(; i < end; ++i) set(i, *in++);
+        }
+
+        template<typename IN> void appendValues(IN const* in, long long n){
+            long long first = size;
+            size += n;
+            growWords();
+            encode(first, n, in);
+        }
+    };
+
+}
+
+#endif // PACKEDVECTOR_H
@@ -0,0 +1,164 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "utils.hpp"
+#include "vector.hpp"
+
+namespace dmk{
+
+    // Work stealing thread pool. Every worker owns a deque, runs its own
+    // newest task first and steals the oldest ones of others, so that a
+    // divide and conquer task tree is split near the root. Threads that
+    // are not workers submit to an extra shared deque. Tasks must not throw.
+    class ThreadPool{
+        struct Task{
+            std::function<void()> f;
+            std::atomic<long long>* pending; // of the group it belongs to
+        };
+        struct Worker{
+            std::mutex lock;
+            std::deque<Task> tasks;
+        };
+        int workerCount;
+        std::unique_ptr<Worker[]> workers; // the last one is shared
+        Vector<std::thread> threads;
+        std::atomic<long long> queued;
+        std::mutex sleepLock;
+        std::condition_variable wakeUp;
+        bool stopping;
+        ThreadPool(ThreadPool const&);
+        ThreadPool& operator=(ThreadPool const&);
+
+        struct Identity{
+            ThreadPool const* pool;
+            int worker;
+        };
+        static Identity& identity(){
+            thread_local Identity result = {nullptr, 0};
+            return result;
+        }
+        int ownQueue()const{
+            return identity().pool == this ? identity().worker : workerCount;
+        }
+
+        bool take(int queue, bool newest, Task& task){
+            Worker& w = workers[queue];
+            std::lock_guard<std::mutex> guard(w.lock);
+            if(w.tasks.empty()) return false;
+            if(newest){
+                task = std::move(w.tasks.back());
+                w.tasks.pop_back();
+            }
+            else {
+                task = std::move(w.tasks.front());
+                w.tasks.pop_front();
+            }
+            --queued;
+            return true;
+        }
+
+        void work(int worker){
+            identity() = Identity{this, worker};
+            for(;;){
+                if(runOne()) continue;
+                std::unique_lock<std::mutex> guard(sleepLock);
+                wakeUp.wait(guard, [this]{return stopping || queued > 0;});
+                if(stopping) return;
+            }
+        }
+    public:
+        // the calling thread helps while waiting, so n workers give n + 1
+        // threads and 0 workers run everything on the caller
+        explicit ThreadPool(int theWorkerCount = defaultWorkerCount()):
+            workerCount(std::max(0, theWorkerCount)),
+            workers(new Worker[workerCount + 1]), queued(0), stopping(false){
+            for(int i = 0; i < workerCount; ++i)
+                threads.append(std::thread(&ThreadPool::work, this, i));
+        }
+
+        static int defaultWorkerCount()
+            {return std::max(1, int(std::thread::hardware_concurrency())) - 1;}
+
+        int getThreadCount()const{return workerCount + 1;}
+
+        void submit(std::function<void()> f, std::atomic<long long>* pending){
+            {
+                Worker& w = workers[ownQueue()];
+                std::lock_guard<std::mutex> guard(w.lock);
+                w.tasks.push_back(Task{std::move(f), pending});
+                ++queued;
+            }
+            // the lock makes sure a worker about to sleep sees the task
+            {std::lock_guard<std::mutex> guard(sleepLock);}
+            wakeUp.notify_one();
+        }
+
+        // runs one task, own ones first, returns false if none was found
+        bool runOne(){
+            if(queued == 0) return false;
+            Task task;
+            int own = ownQueue();
+            bool found = take(own, true, task);
+            for(int i = 1; !found && i <= workerCount; ++i)
+                found = take((own + i) % (workerCount + 1), false, task);
+            if(!found) return false;
+            task.f();
+            --*task.pending;
+            return true;
+        }
+
+        ~ThreadPool(){
+            {
+                std::lock_guard<std::mutex> guard(sleepLock);
+                stopping = true;
+            }
+            wakeUp.notify_all();
+            for(int i = 0; i < threads.getSize(); ++i) threads[i].join();
+        }
+    };
+
+    // Fork join scope, tasks spawned from tasks may use the same group
+    class TaskGroup{
+        ThreadPool& pool;
+        std::atomic<long long> pending;
+        TaskGroup(TaskGroup const&);
+        TaskGroup& operator=(TaskGroup const&);
+    public:
+        TaskGroup(ThreadPool& thePool): pool(thePool), pending(0) {}
+
+        template<typename FUNCTION> void spawn(FUNCTION f){
+            ++pending;
+            pool.submit(std::function<void()>(std::move(f)), &pending);
+        }
+
+        // runs queued tasks, possibly of other groups, until all are done
+        void wait(){
+            while(pending > 0) if(!pool.runOne()) std::this_thread::yield();
+        }
+
+        ~TaskGroup(){wait();}
+    };
+
+    // f(i, j) for consecutive ranges [i, j) of at most grain items
+    template<typename FUNCTION>
+    void parallelFor(ThreadPool& pool, long long begin, long long end,
+        long long grain, FUNCTION const& f){
+        TaskGroup tasks(pool);
+        for(long long i = begin; i < end; i += grain){
+            long long j = std::min(end, i + grain);
+            if(j < end) tasks.spawn([&f, i, j]{f(i, j);});
+            else f(i, j);
+        }
+        tasks.wait();
+    }
+
+}
+
+#endif // PARALLEL_H
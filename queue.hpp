@@ -4,21 +4,24 @@
 #include <algorithm>
 #include "utils.hpp"
 #include "vector.hpp"
+#include "allocator.hpp"
 
 namespace dmk{
 
-	template<typename ITEM>
+	template<typename ITEM, typename ALLOCATOR = DefaultAllocator>
     class Queue{
         enum{MIN_CAPACITY=8};
+        [[no_unique_address]] ALLOCATOR allocator;
         int capacity, front, size;
         ITEM* items;
         int offset(int i)const{return (front+i) % capacity;}
+        ITEM* allocateItems(int n){return (ITEM*)allocator.allocate(sizeof(ITEM) * n);}
         void resize(){
             ITEM* oldArray = items;
             int newCapacity = std::max(int(MIN_CAPACITY), size * 2);
-            items = rawMemory<ITEM>(newCapacity);
-            // copy over old items
-            for(int i = 0; i < size; ++i) new(&items[i])ITEM(oldArray[offset(i)]);
+            items = allocateItems(newCapacity);
+            // move over old items
+            for(int i = 0; i < size; ++i) new(&items[i])ITEM(std::move(oldArray[offset(i)]));
             // delete previous array
             deleteArray(oldArray);
             front = 0;
@@ -27,7 +30,7 @@ namespace dmk{
 
         void deleteArray(ITEM* array){
             for(int i =0; i < size; ++i) array[offset(i)].~ITEM();
-            rawDelete(array);
+            allocator.deallocate(array, sizeof(ITEM) * capacity);
         }
     public:
         bool isEmpty()const{return size == 0;}
@@ -43,18 +46,21 @@ namespace dmk{
             return items[offset(i)];
         }
 
-        Queue(int theCapacity = MIN_CAPACITY):
+        Queue(int theCapacity = MIN_CAPACITY,
+            ALLOCATOR const& theAllocator = ALLOCATOR()):
+            allocator(theAllocator),
             capacity(std::max(int(MIN_CAPACITY), theCapacity)),
             front(0),
             size(0),
-            items(rawMemory<ITEM>(capacity)) {}
+            items(allocateItems(capacity)) {}
 
         Queue(Queue const& rhs):
+            allocator(rhs.allocator),
             capacity(std::max(int(MIN_CAPACITY), rhs.capacity)),
             front(0),
             size(0),
-            items(rawMemory<ITEM>(capacity)) {
-            for(int i=0; i < size; ++i) push(rhs[i]);
+            items(allocateItems(capacity)) {
+            for(int i=0; i < rhs.size; ++i) push(rhs[i]);
         }
 
         Queue& operator=(Queue const& rhs){return genericAssign(*this, rhs);}
@@ -2,6 +2,7 @@
 #define RANDOM_H
 
 #include <stdint.h>
+#include <cassert>
 #include <time.h>
 #include <limits>
 #include <algorithm>
@@ -34,6 +35,7 @@ class MersenneTwister64 {
     int i;
 public:
     MersenneTwister64(uint64_t seed = time(0) ^ PASSWORD){
+        state[0] = seed;
         for(i = 1; i < N; ++i)
             state[i] = 6364136223846793005ULL * 
                 (state[i - 1] ^ (state[i -1] >> 62)) + 1;
@@ -75,7 +77,8 @@ public:
         return (c1 <= c2 ? m1 : 0) + c1 - c2;
     }
     unsigned long long maxNextValue(){return m1;}
-    MRG32k3a(): s10(std::max(time(0) ^ PASSWORD, 1l)), s11(0), s12(0),
+    MRG32k3a(unsigned long long seed = time(0) ^ PASSWORD):
+        s10(std::max<long long>(seed % m2, 1)), s11(0), s12(0),
         s20(s10), s21(0), s22(0) {}
     double uniform01(){return 2.32830643653869629E-10 * next();}
     void jumpAhead(){
@@ -121,7 +124,7 @@ struct ARC4{
     unsigned char nextByte(){
         j += sBox[++i];
         std::swap(sBox[i], sBox[j]);
-        return sBox[(sBox[i] + sBox[j]) & 256];
+        return sBox[(sBox[i] + sBox[j]) & 255];
     }
     unsigned long long next(){
         unsigned long long result = 0;
@@ -0,0 +1,151 @@
+#ifndef RANKSELECT_H
+#define RANKSELECT_H
+
+#include "bits.hpp"
+#include "vector.hpp"
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+namespace dmk{
+
+    // Read-only rank/select directory over the words of a Bitset, which
+    // must outlive it and not change. Blocks of 2048 bits have a 64 bit
+    // entry with the count before the block (relative to its 2^32 bit
+    // top level) and the counts of their first three 512 bit subblocks,
+    // about 3% of space. Every SAMPLE_RATE-th one and zero records its
+    // block to narrow the select search, under 1% more.
+    class RankSelect{
+        enum{BLOCK_BITS = 2048, BLOCK_SHIFT = 11, BLOCK_WORDS = 32,
+            SUBBLOCK_SHIFT = 9, SUBBLOCK_WORDS = 8, TOP_SHIFT = 32,
+            SAMPLE_RATE = 8192};
+        unsigned long long const* words;
+        long long wordCount;
+        unsigned long long bitSize, ones;
+        Vector<unsigned long long> top, blocks;
+        Vector<unsigned int> oneSamples, zeroSamples;
+
+        static int subblockCount(unsigned long long entry, int s)
+            {return (entry >> (20 - 10 * s)) & 1023;}
+
+        unsigned long long word(long long w)const{return w < wordCount ? words[w] : 0;}
+
+        // ones before block b
+        unsigned long long blockRank(long long b)const{
+            return top[(unsigned long long)b << BLOCK_SHIFT >> TOP_SHIFT] + (blocks[b] >> 32);
+        }
+        unsigned long long blockRank0(long long b)const
+            {return ((unsigned long long)b << BLOCK_SHIFT) - blockRank(b);}
+
+        template<bool ONES> unsigned long long rankOf(long long b)const
+            {return ONES ? blockRank(b) : blockRank0(b);}
+
+        template<bool ONES> void buildSamples(Vector<unsigned int>& samples){
+            unsigned long long next = 0;
+            long long blockCount = blocks.getSize() - 1;
+            for(long long b = 0; b < blockCount; ++b){
+                unsigned long long end = rankOf<ONES>(b + 1);
+                if(!ONES && b == blockCount - 1) end = bitSize - ones;
+                for(; next < end; next += SAMPLE_RATE) samples.append(b);
+            }
+        }
+
+        template<bool ONES> unsigned long long select(unsigned long long k,
+            Vector<unsigned int> const& samples)const{
+            // last block with fewer than k + 1 items before it
+            long long sample = k / SAMPLE_RATE, left = samples[sample],
+                right = sample + 1 < samples.getSize() ? samples[sample + 1] :
+                blocks.getSize() - 2;
+            while(left < right){
+                long long middle = left + (right - left + 1) / 2;
+                if(rankOf<ONES>(middle) <= k) left = middle;
+                else right = middle - 1;
+            }
+            k -= rankOf<ONES>(left);
+            unsigned long long entry = blocks[left];
+            int s = 0;
+            for(; s < 3; ++s){
+                int count = subblockCount(entry, s);
+                if(!ONES) count = (1 << SUBBLOCK_SHIFT) - count;
+                if(k < (unsigned long long)count) break;
+                k -= count;
+            }
+            for(long long w = left * BLOCK_WORDS + s * SUBBLOCK_WORDS;; ++w){
+                unsigned long long x = ONES ? word(w) : ~word(w);
+                int count = popCountWord(x);
+                if(k < (unsigned long long)count) return w * 64 + selectInWord(x, k);
+                k -= count;
+            }
+        }
+    public:
+        template<typename WORD, typename ALLOCATOR>
+        RankSelect(Bitset<WORD, ALLOCATOR> const& bitset):
+            words(bitset.getStorage().getArray()),
+            wordCount(bitset.wordSize()), bitSize(bitset.getSize()), ones(0){
+            static_assert(sizeof(WORD) == sizeof(unsigned long long), "64 bit words only");
+            long long blockCount = ceiling(bitSize, BLOCK_BITS);
+            for(long long b = 0; b <= blockCount; ++b){
+                unsigned long long position = (unsigned long long)b << BLOCK_SHIFT;
+                if(position % (1ull << TOP_SHIFT) == 0) top.append(ones);
+                unsigned long long entry = (ones - top.lastItem()) << 32;
+                for(int s = 0; s < 4; ++s){
+                    int count = 0;
+                    for(int j = 0; j < SUBBLOCK_WORDS; ++j)
+                        count += popCountWord(word(b * BLOCK_WORDS + s * SUBBLOCK_WORDS + j));
+                    if(s < 3) entry |= (unsigned long long)count << (20 - 10 * s);
+                    ones += count;
+                }
+                blocks.append(entry);
+            }
+            buildSamples<true>(oneSamples);
+            buildSamples<false>(zeroSamples);
+        }
+
+        unsigned long long getSize()const{return bitSize;}
+        unsigned long long getOnes()const{return ones;}
+        unsigned long long getZeros()const{return bitSize - ones;}
+
+        // number of ones in [0, i)
+        unsigned long long rank1(unsigned long long i)const{
+            assert(i <= bitSize);
+            long long b = i >> BLOCK_SHIFT, w = b * BLOCK_WORDS, end = i >> 6;
+            unsigned long long entry = blocks[b], result = blockRank(b);
+            int s = (i >> SUBBLOCK_SHIFT) & 3;
+            for(int j = 0; j < s; ++j) result += subblockCount(entry, j);
+            for(w += s * SUBBLOCK_WORDS; w < end; ++w) result += popCountWord(words[w]);
+            if(i & 63) result += popCountWord(words[end] & bits::lowerMask(i & 63));
+            return result;
+        }
+        unsigned long long rank0(unsigned long long i)const{return i - rank1(i);}
+
+        // position of the k-th one or zero, counting from 0
+        unsigned long long select1(unsigned long long k)const{
+            assert(k < getOnes());
+            return select<true>(k, oneSamples);
+        }
+        unsigned long long select0(unsigned long long k)const{
+            assert(k < getZeros());
+            return select<false>(k, zeroSamples);
+        }
+
+        static int selectInWord(unsigned long long x, int k){
+            assert(k < popCountWord(x));
+#ifdef __BMI2__
+            return __builtin_ctzll(_pdep_u64(1ull << k, x));
+#else
+            // prefix sums of byte counts find the byte, then clear lower ones
+            unsigned long long s = x - ((x >> 1) & 0x5555555555555555ull);
+            s = (s & 0x3333333333333333ull) + ((s >> 2) & 0x3333333333333333ull);
+            s = ((s + (s >> 4)) & 0x0f0f0f0f0f0f0f0full) * 0x0101010101010101ull;
+            int byte = 0;
+            while(int((s >> (8 * byte)) & 0xff) <= k) ++byte;
+            if(byte > 0) k -= (s >> (8 * (byte - 1))) & 0xff;
+            unsigned int b = (x >> (8 * byte)) & 0xff;
+            for(; k > 0; --k) b &= b - 1;
+            return 8 * byte + __builtin_ctz(b);
+#endif
+        }
+    };
+}
+
+#endif // RANKSELECT_H
@@ -0,0 +1,194 @@
+#ifndef SMALLVECTOR_H
+#define SMALLVECTOR_H
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include "utils.hpp"
+
+namespace dmk{
+
+    template<typename ITEM, int N> struct SmallVectorBuffer{
+        typename std::aligned_storage<sizeof(ITEM), alignof(ITEM)>::type buffer[N];
+        ITEM* inlineItems(){return (ITEM*)buffer;}
+        ITEM const* inlineItems()const{return (ITEM const*)buffer;}
+    };
+    template<typename ITEM> struct SmallVectorBuffer<ITEM, 0>{
+        // empty base, a zero size vector costs no space and never allocates
+        // until the first append
+        ITEM* inlineItems(){return nullptr;}
+        ITEM const* inlineItems()const{return nullptr;}
+    };
+
+    // Keeps up to N items inline, goes to the heap only when they don't fit
+    template<typename ITEM, int N = 8>
+    class SmallVector: private SmallVectorBuffer<ITEM, N>{
+        enum{MIN_HEAP_CAPACITY = 4};
+        int size, capacity;
+        ITEM* items; // points to the inline buffer or to the heap
+        using SmallVectorBuffer<ITEM, N>::inlineItems;
+
+        bool isInline()const{return items == inlineItems();}
+
+        static void relocate(ITEM* to, ITEM* from, int n){
+            if(std::is_trivially_copyable<ITEM>::value){
+                if(n > 0) std::memcpy((void*)to, (void const*)from, sizeof(ITEM) * n);
+            }
+            else for(int i = 0; i < n; ++i){
+                new(&to[i])ITEM(std::move(from[i]));
+                from[i].~ITEM();
+            }
+        }
+
+        void reallocate(int newCapacity){
+            assert(newCapacity >= size);
+            if(newCapacity == capacity) return;
+            if(newCapacity <= N){ // back to inline storage
+                if(isInline()) return;
+                ITEM* oldItems = items;
+                items = inlineItems();
+                relocate(items, oldItems, size);
+                rawDelete(oldItems);
+                newCapacity = N;
+            }
+            else if(!isInline() && std::is_trivially_copyable<ITEM>::value){
+                // never compiled for other items, realloc would move them as bytes
+                if constexpr(std::is_trivially_copyable<ITEM>::value)
+                    items = rawReallocate(items, newCapacity);
+            }
+            else {
+                ITEM* oldItems = items;
+                items = rawMemory<ITEM>(newCapacity);
+                relocate(items, oldItems, size);
+                if(oldItems != inlineItems()) rawDelete(oldItems);
+            }
+            capacity = newCapacity;
+        }
+
+        void moveFrom(SmallVector& rhs){
+            // steal a heap buffer, inline items have to be moved one by one
+            if(rhs.isInline()){
+                relocate(items, rhs.items, rhs.size);
+                size = rhs.size;
+            }
+            else {
+                items = rhs.items;
+                size = rhs.size;
+                capacity = rhs.capacity;
+                rhs.items = rhs.inlineItems();
+                rhs.capacity = N;
+            }
+            rhs.size = 0;
+        }
+    public:
+        ITEM* getArray(){return items;}
+        ITEM const* getArray()const{return items;}
+
+        int getSize()const{return size;}
+        int getCapacity()const{return capacity;}
+
+        ITEM& operator[](int i){
+            assert(i >= 0 && i < size);
+            return items[i];
+        }
+        ITEM const& operator[](int i)const{
+            assert(i >= 0 && i < size);
+            return items[i];
+        }
+
+        SmallVector(): size(0), capacity(N), items(inlineItems()) {}
+
+        explicit SmallVector(int initialSize, ITEM const& value = ITEM()): SmallVector(){
+            reserve(initialSize);
+            for(int i = 0; i < initialSize; ++i) append(value);
+        }
+
+        SmallVector(std::initializer_list<ITEM> list): SmallVector(){
+            reserve(list.size());
+            for(auto p = list.begin(); p != list.end(); p++) append(*p);
+        }
+
+        SmallVector(SmallVector const& rhs): SmallVector(){
+            reserve(rhs.size);
+            for(int i = 0; i < rhs.size; ++i) new(&items[i])ITEM(rhs.items[i]);
+            size = rhs.size;
+        }
+
+        // inline items are moved one by one, so only as safe as their moves
+        SmallVector(SmallVector&& rhs)noexcept(std::is_nothrow_move_constructible<ITEM>::value):
+            SmallVector(){moveFrom(rhs);}
+
+        SmallVector& operator=(SmallVector const& rhs){
+            return genericAssign(*this, rhs);
+        }
+
+        SmallVector& operator=(SmallVector&& rhs)
+            noexcept(std::is_nothrow_move_constructible<ITEM>::value){
+            if(this != &rhs){
+                clear();
+                if(!isInline()) rawDelete(items);
+                items = inlineItems();
+                capacity = N;
+                moveFrom(rhs);
+            }
+            return *this;
+        }
+
+        ~SmallVector(){
+            for(int i = 0; i < size; ++i) items[i].~ITEM();
+            if(!isInline()) rawDelete(items);
+        }
+
+        void clear(){
+            for(int i = 0; i < size; ++i) items[i].~ITEM();
+            size = 0;
+        }
+
+        void resize(){reallocate(std::max(2 * size, int(MIN_HEAP_CAPACITY)));}
+
+        void reserve(int n){if(n > capacity) reallocate(n);}
+
+        void shrinkToFit(){if(capacity > size) reallocate(size);}
+
+        template<typename... ARGUMENTS> void emplaceAppend(ARGUMENTS&&... args){
+            if(size >= capacity){
+                // arguments may refer into items, so construct before growing
+                ITEM item(std::forward<ARGUMENTS>(args)...);
+                resize();
+                new(&items[size++])ITEM(std::move(item));
+            }
+            else new(&items[size++])ITEM(std::forward<ARGUMENTS>(args)...);
+        }
+
+        void append(ITEM const& item){emplaceAppend(item);}
+        void append(ITEM&& item){emplaceAppend(std::move(item));}
+
+        void removeLast(){
+            assert(size > 0);
+            items[--size].~ITEM();
+            if(!isInline() && size * 4 < capacity) resize();
+        }
+
+        void swapWith(SmallVector& other){
+            SmallVector temp(std::move(other));
+            other = std::move(*this);
+            *this = std::move(temp);
+        }
+
+        ITEM const& lastItem()const{return items[size - 1];}
+        ITEM& lastItem(){return items[size - 1];}
+        void reverse(int left, int right){while(left < right) std::swap(items[left++], items[right--]);}
+        void reverse(){reverse(0, size - 1);}
+
+        bool operator==(SmallVector const& rhs)const{
+            if(size == rhs.size){
+                for(int i = 0; i < size; ++i) if(items[i] != rhs[i]) return false;
+                return true;
+            }
+            return false;
+        }
+    };
+
+}
+
+#endif // SMALLVECTOR_H
@@ -3,7 +3,12 @@
 #include "utils.hpp"
 #include "vector.hpp"
 #include "random.hpp"
+#include "parallel.hpp"
+#include "bits.hpp"
+#include "sortingnetwork.hpp"
 #include <algorithm>
+#include <cstring>
+#include <type_traits>
 
 namespace dmk{
 
@@ -19,20 +24,38 @@ void insertionSort(ITEM* vector, int left, int right, COMPARATOR const& c){
     }
 }
 
+// the base case of the recursive sorts
 template<typename ITEM, typename COMPARATOR>
-int pickPivot(ITEM* vector, int left, int right, COMPARATOR c){
-    int i = GlobalRNG().inRange(left, right),
-        j = GlobalRNG().inRange(left, right),
-        k = GlobalRNG().inRange(left, right);
+void sortLeaf(ITEM* vector, int left, int right, COMPARATOR const& c){
+    if constexpr(HasSortingNetwork<ITEM, COMPARATOR>::value)
+        networkSort(vector + left, right - left + 1);
+    else insertionSort(vector, left, right, c);
+}
+// the same for the stable sorts
+template<typename ITEM, typename COMPARATOR>
+void sortStableLeaf(ITEM* vector, int left, int right, COMPARATOR const& c){
+    if constexpr(HasStableSortingNetwork<ITEM, COMPARATOR>::value)
+        networkSort(vector + left, right - left + 1);
+    else insertionSort(vector, left, right, c);
+}
+
+template<typename ITEM, typename COMPARATOR>
+int pickPivot(ITEM* vector, int left, int right, COMPARATOR c, Random<>& random = GlobalRNG()){
+    int i = random.inRange(left, right),
+        j = random.inRange(left, right),
+        k = random.inRange(left, right);
     if (c(vector[j], vector[i])) std::swap(i, j);
     // i <= j, decide where k goes
     return c(vector[k], vector[i]) ? i : c(vector[k], vector[j]) ?  k : j;
 }
 
+// after it [left, j] are less than the pivot, which must be one of the
+// items, [i, right] greater and those between equal
 template<typename ITEM, typename COMPARATOR>
-void partition3(ITEM* vector, int left, int right, int& i, int& j, COMPARATOR const& c){
+void partitionAround(ITEM* vector, int left, int right, int& i, int& j,
+    COMPARATOR const& c, ITEM const& pivot){
     // i, j are the current left/right pointers
-    ITEM p = vector[pickPivot(vector, left, right, c)];
+    ITEM p = pivot;
     int lastLeftEqual = i = left - 1, firstRightEqual = j = right + 1;
     for(;;) // the pivot is the sentinel for the first pass
     { //after one swap swapped items act as sentinels
@@ -58,28 +81,487 @@ void partition3(ITEM* vector, int left, int right, int& i, int& j, COMPARATOR co
 }
 
 template<typename ITEM, typename COMPARATOR>
-void quickSort(ITEM* vector, int left, int right, COMPARATOR const& c){
+void partition3(ITEM* vector, int left, int right, int& i, int& j, COMPARATOR const& c,
+    Random<>& random = GlobalRNG()){
+    partitionAround(vector, left, right, i, j, c, vector[pickPivot(vector, left, right, c, random)]);
+}
+
+template<typename ITEM, typename COMPARATOR>
+void quickSort(ITEM* vector, int left, int right, COMPARATOR const& c,
+    Random<>& random = GlobalRNG()){
     // use quicksort for large arrays
-    while(right - left > 16){
+    while(right - left >= 16){
         int i, j;
-        partition3(vector, left, right, i, j, c);
+        partition3(vector, left, right, i, j, c, random);
         if (j - left < right -i) // pick smaller
         {
-            quickSort(vector, left, j, c);
+            quickSort(vector, left, j, c, random);
             left = i;
         } else {
-            quickSort(vector, i, right, c);
+            quickSort(vector, i, right, c, random);
             right = j;
         }
     }
-    // use insertionSort for small arrays
-    insertionSort(vector, left, right, c);
+    // use a sorting network or insertionSort for small arrays
+    sortLeaf(vector, left, right, c);
 }
 
 template<typename ITEM> void quickSort(ITEM* vector, int n){
     quickSort(vector, 0, n-1, DefaultComparator<ITEM>());
 }
 
+template<typename ITEM, typename COMPARATOR>
+void parallelQuickSortTask(ITEM* vector, int left, int right, COMPARATOR const& c,
+    TaskGroup& tasks, unsigned long long seed, int cutoff){
+    // the global generator is not thread safe, each task has its own
+    Random<> random(seed + left);
+    while(right - left > cutoff){
+        int i, j;
+        partition3(vector, left, right, i, j, c, random);
+        // give away the larger part, keep partitioning the smaller one
+        if(j - left < right - i){
+            tasks.spawn([=, &c, &tasks]{parallelQuickSortTask(vector, i, right, c, tasks, seed, cutoff);});
+            right = j;
+        } else {
+            tasks.spawn([=, &c, &tasks]{parallelQuickSortTask(vector, left, j, c, tasks, seed, cutoff);});
+            left = i;
+        }
+    }
+    quickSort(vector, left, right, c, random);
+}
+
+// parts of at most cutoff items are sorted sequentially
+template<typename ITEM, typename COMPARATOR>
+void quickSort(ITEM* vector, int left, int right, COMPARATOR const& c,
+    ThreadPool& pool, int cutoff = 1 << 13){
+    TaskGroup tasks(pool);
+    parallelQuickSortTask(vector, left, right, c, tasks, GlobalRNG().next(), std::max(cutoff, 16));
+    tasks.wait();
+}
+
+template<typename ITEM> void quickSort(ITEM* vector, int n, ThreadPool& pool){
+    quickSort(vector, 0, n-1, DefaultComparator<ITEM>(), pool);
+}
+
+template<typename ITEM, typename COMPARATOR>
+void siftDown(ITEM* heap, int i, int n, COMPARATOR const& c){
+    ITEM item(std::move(heap[i]));
+    for(int child; (child = 2 * i + 1) < n; i = child){
+        if(child + 1 < n && c(heap[child], heap[child + 1])) ++child;
+        if(!c(item, heap[child])) break;
+        heap[i] = std::move(heap[child]);
+    }
+    heap[i] = std::move(item);
+}
+
+template<typename ITEM, typename COMPARATOR>
+void heapSort(ITEM* vector, int left, int right, COMPARATOR const& c){
+    ITEM* heap = vector + left;
+    int n = right - left + 1;
+    for(int i = n / 2 - 1; i >= 0; --i) siftDown(heap, i, n, c);
+    for(int i = n - 1; i > 0; --i){
+        std::swap(heap[0], heap[i]);
+        siftDown(heap, 0, i, c);
+    }
+}
+
+// Pattern defeating quicksort, after Peters, with the block partitioning
+// of Edelkamp and Weiss: comparisons only record offsets of misplaced
+// items, which are swapped in a second loop, so there is no branch on
+// their outcome. Pivots are deterministic medians of 3 or ninthers; a
+// partition that leaves less than 1/8 on a side is bad, after lg n bad
+// ones the range is heap sorted.
+namespace pdq{
+    enum{INSERTION_SORT_THRESHOLD = 24, NINTHER_THRESHOLD = 128,
+        PARTIAL_INSERTION_SORT_LIMIT = 8, BLOCK_SIZE = 64};
+
+    // the item before begin is a sentinel, no bounds check
+    template<typename ITEM, typename COMPARATOR>
+    void unguardedInsertionSort(ITEM* begin, ITEM* end, COMPARATOR const& c){
+        for(ITEM* i = begin + 1; i < end; ++i){
+            if(c(*i, *(i - 1))){
+                ITEM item(std::move(*i));
+                ITEM* j = i;
+                do{*j = std::move(*(j - 1));} while(c(item, *(--j - 1)));
+                *j = std::move(item);
+            }
+        }
+    }
+
+    // gives up after moving more than the limit, for nearly sorted ranges
+    template<typename ITEM, typename COMPARATOR>
+    bool partialInsertionSort(ITEM* begin, ITEM* end, COMPARATOR const& c){
+        long long moves = 0;
+        for(ITEM* i = begin + 1; i < end; ++i){
+            if(c(*i, *(i - 1))){
+                ITEM item(std::move(*i));
+                ITEM* j = i;
+                do{*j = std::move(*(j - 1));} while(--j > begin && c(item, *(j - 1)));
+                *j = std::move(item);
+                moves += i - j;
+            }
+            if(moves > PARTIAL_INSERTION_SORT_LIMIT) return false;
+        }
+        return true;
+    }
+
+    template<typename ITEM, typename COMPARATOR>
+    void sort3(ITEM* a, ITEM* b, ITEM* d, COMPARATOR const& c){
+        if(c(*b, *a)) std::swap(*a, *b);
+        if(c(*d, *b)) std::swap(*b, *d);
+        if(c(*b, *a)) std::swap(*a, *b);
+    }
+
+    template<typename ITEM>
+    void swapOffsets(ITEM* first, ITEM* last, unsigned char const* left,
+        unsigned char const* right, int n, bool sameCount){
+        if(sameCount) for(int i = 0; i < n; ++i)
+            std::swap(first[left[i]], *(last - right[i]));
+        else if(n > 0){ // a cyclic permutation, fewer moves than swaps
+            ITEM *l = first + left[0], *r = last - right[0];
+            ITEM item(std::move(*l));
+            *l = std::move(*r);
+            for(int i = 1; i < n; ++i){
+                l = first + left[i];
+                *r = std::move(*l);
+                r = last - right[i];
+                *l = std::move(*r);
+            }
+            *r = std::move(item);
+        }
+    }
+
+    // partitions around *begin into < and >=, returns the pivot position
+    // and whether no items had to be moved
+    template<typename ITEM, typename COMPARATOR>
+    std::pair<ITEM*, bool> partitionRight(ITEM* begin, ITEM* end, COMPARATOR const& c){
+        ITEM pivot(std::move(*begin));
+        ITEM *first = begin, *last = end;
+        // the median of 3 guarantees an item >= pivot on the right
+        while(c(*++first, pivot));
+        if(first - 1 == begin) while(first < last && !c(*--last, pivot));
+        else while(!c(*--last, pivot));
+        bool alreadyPartitioned = first >= last;
+        if(!alreadyPartitioned){
+            std::swap(*first, *last);
+            ++first;
+            unsigned char leftOffsets[BLOCK_SIZE], rightOffsets[BLOCK_SIZE];
+            ITEM *leftBase = first, *rightBase = last;
+            int leftCount = 0, rightCount = 0, leftStart = 0, rightStart = 0;
+            while(first < last){
+                // refill the empty blocks, splitting what's left if both are
+                int unknown = last - first,
+                    leftSplit = leftCount == 0 ? (rightCount == 0 ? unknown / 2 : unknown) : 0,
+                    rightSplit = rightCount == 0 ? unknown - leftSplit : 0;
+                for(int i = 0, m = std::min<int>(leftSplit, BLOCK_SIZE); i < m; ++i){
+                    leftOffsets[leftCount] = i;
+                    leftCount += !c(*first++, pivot);
+                }
+                for(int i = 0, m = std::min<int>(rightSplit, BLOCK_SIZE); i < m;){
+                    rightOffsets[rightCount] = ++i;
+                    rightCount += c(*--last, pivot);
+                }
+                int n = std::min(leftCount, rightCount);
+                swapOffsets(leftBase, rightBase, leftOffsets + leftStart,
+                    rightOffsets + rightStart, n, leftCount == rightCount);
+                leftCount -= n;
+                rightCount -= n;
+                leftStart += n;
+                rightStart += n;
+                if(leftCount == 0){
+                    leftStart = 0;
+                    leftBase = first;
+                }
+                if(rightCount == 0){
+                    rightStart = 0;
+                    rightBase = last;
+                }
+            }
+            // leftovers of one block go to the far end of the other side
+            if(leftCount){
+                while(leftCount--) std::swap(leftBase[leftOffsets[leftStart + leftCount]], *--last);
+                first = last;
+            }
+            if(rightCount){
+                while(rightCount--) std::swap(*(rightBase - rightOffsets[rightStart + rightCount]), *first++);
+                last = first;
+            }
+        }
+        ITEM* pivotPosition = first - 1;
+        *begin = std::move(*pivotPosition);
+        *pivotPosition = std::move(pivot);
+        return std::make_pair(pivotPosition, alreadyPartitioned);
+    }
+
+    // partitions around *begin into <= and >, used when the pivot equals
+    // the item before the range, so all of <= are equal and done
+    template<typename ITEM, typename COMPARATOR>
+    ITEM* partitionLeft(ITEM* begin, ITEM* end, COMPARATOR const& c){
+        ITEM pivot(std::move(*begin));
+        ITEM *first = begin, *last = end;
+        while(c(pivot, *--last));
+        if(last + 1 == end) while(first < last && !c(pivot, *++first));
+        else while(!c(pivot, *++first));
+        while(first < last){
+            std::swap(*first, *last);
+            while(c(pivot, *--last));
+            while(!c(pivot, *++first));
+        }
+        *begin = std::move(*last);
+        *last = std::move(pivot);
+        return last;
+    }
+
+    template<typename ITEM, typename COMPARATOR>
+    void sortLoop(ITEM* begin, ITEM* end, COMPARATOR const& c, int badAllowed, bool leftmost){
+        for(;;){
+            int size = end - begin;
+            if(size < INSERTION_SORT_THRESHOLD){
+                if constexpr(HasSortingNetwork<ITEM, COMPARATOR>::value) networkSort(begin, size);
+                else if(leftmost) insertionSort(begin, 0, size - 1, c);
+                else unguardedInsertionSort(begin, end, c);
+                return;
+            }
+            // the pivot ends up in *begin
+            int half = size / 2;
+            if(size > NINTHER_THRESHOLD){
+                sort3(begin, begin + half, end - 1, c);
+                sort3(begin + 1, begin + half - 1, end - 2, c);
+                sort3(begin + 2, begin + half + 1, end - 3, c);
+                sort3(begin + half - 1, begin + half, begin + half + 1, c);
+                std::swap(*begin, *(begin + half));
+            }
+            else sort3(begin + half, begin, end - 1, c);
+
+            // many equal items, skip the ones equal to the previous pivot
+            if(!leftmost && !c(*(begin - 1), *begin)){
+                begin = partitionLeft(begin, end, c) + 1;
+                continue;
+            }
+
+            std::pair<ITEM*, bool> result = partitionRight(begin, end, c);
+            ITEM* pivot = result.first;
+            int leftSize = pivot - begin, rightSize = end - (pivot + 1);
+            if(leftSize < size / 8 || rightSize < size / 8){
+                if(--badAllowed == 0){
+                    heapSort(begin, 0, size - 1, c);
+                    return;
+                }
+                // break patterns with fixed swaps
+                if(leftSize >= INSERTION_SORT_THRESHOLD){
+                    int q = leftSize / 4;
+                    std::swap(*begin, *(begin + q));
+                    std::swap(*(pivot - 1), *(pivot - q));
+                    if(leftSize > NINTHER_THRESHOLD){
+                        std::swap(*(begin + 1), *(begin + q + 1));
+                        std::swap(*(begin + 2), *(begin + q + 2));
+                        std::swap(*(pivot - 2), *(pivot - q - 1));
+                        std::swap(*(pivot - 3), *(pivot - q - 2));
+                    }
+                }
+                if(rightSize >= INSERTION_SORT_THRESHOLD){
+                    int q = rightSize / 4;
+                    std::swap(*(pivot + 1), *(pivot + 1 + q));
+                    std::swap(*(end - 1), *(end - q));
+                    if(rightSize > NINTHER_THRESHOLD){
+                        std::swap(*(pivot + 2), *(pivot + 2 + q));
+                        std::swap(*(pivot + 3), *(pivot + 3 + q));
+                        std::swap(*(end - 2), *(end - q - 1));
+                        std::swap(*(end - 3), *(end - q - 2));
+                    }
+                }
+            }
+            // a good partition that moved nothing may be of sorted input
+            else if(result.second && partialInsertionSort(begin, pivot, c) &&
+                partialInsertionSort(pivot + 1, end, c)) return;
+
+            sortLoop(begin, pivot, c, badAllowed, leftmost);
+            begin = pivot + 1;
+            leftmost = false;
+        }
+    }
+}
+
+// Unstable, O(n lg n) worst case, linear on sorted and strictly
+// descending input. Deterministic, unlike quickSort, and doesn't use
+// isEqual of the comparator.
+template<typename ITEM, typename COMPARATOR>
+void pdqSort(ITEM* vector, int left, int right, COMPARATOR const& c){
+    ITEM *begin = vector + left, *end = vector + right + 1;
+    if(end - begin < 2) return;
+    // check for one ascending or strictly descending run
+    ITEM* i = begin + 1;
+    if(c(*i, *begin)){
+        while(++i < end && c(*i, *(i - 1)));
+        if(i == end){
+            std::reverse(begin, end);
+            return;
+        }
+    }
+    else {
+        while(++i < end && !c(*i, *(i - 1)));
+        if(i == end) return;
+    }
+    pdq::sortLoop(begin, end, c, lgFloor(end - begin), true);
+}
+
+template<typename ITEM> void pdqSort(ITEM* vector, int n){
+    pdqSort(vector, 0, n - 1, DefaultComparator<ITEM>());
+}
+
+template<typename ITEM, typename COMPARATOR>
+void linearSelect(ITEM* vector, int left, int right, int k, COMPARATOR const& c);
+
+// an item between the 30th and 70th percentiles, moves the medians of
+// groups of 5 to the front of the range
+template<typename ITEM, typename COMPARATOR>
+int medianOfMedians(ITEM* vector, int left, int right, COMPARATOR const& c){
+    int medians = left;
+    for(int i = left; i <= right; i += 5){
+        int last = std::min(i + 4, right);
+        insertionSort(vector, i, last, c);
+        std::swap(vector[medians++], vector[i + (last - i) / 2]);
+    }
+    int middle = left + (medians - left - 1) / 2;
+    linearSelect(vector, left, medians - 1, middle, c);
+    return middle;
+}
+
+// nthElement with median of medians pivots, linear in the worst case
+template<typename ITEM, typename COMPARATOR>
+void linearSelect(ITEM* vector, int left, int right, int k, COMPARATOR const& c){
+    while(right - left >= 16){
+        int i, j;
+        partitionAround(vector, left, right, i, j, c,
+            vector[medianOfMedians(vector, left, right, c)]);
+        if(k <= j) right = j;
+        else if(k >= i) left = i;
+        else return;
+    }
+    sortLeaf(vector, left, right, c);
+}
+
+// Puts the item that goes to position k in a sorted range there, with no
+// greater ones before it and no smaller ones after it. Introselect:
+// quickSort partitions on the side of k, expected linear, and after lg n
+// bad partitions that keep more than 3/4 of the range linearSelect takes
+// over.
+template<typename ITEM, typename COMPARATOR>
+void nthElement(ITEM* vector, int left, int right, int k, COMPARATOR const& c,
+    Random<>& random = GlobalRNG()){
+    assert(left <= k && k <= right);
+    int badAllowed = lgFloor(right - left + 1);
+    while(right - left >= 16){
+        int i, j, size = right - left + 1;
+        partition3(vector, left, right, i, j, c, random);
+        if(k <= j) right = j;
+        else if(k >= i) left = i;
+        else return;
+        if(4 * (right - left + 1) > 3 * size && --badAllowed <= 0){
+            linearSelect(vector, left, right, k, c);
+            return;
+        }
+    }
+    sortLeaf(vector, left, right, c);
+}
+
+template<typename ITEM> void nthElement(ITEM* vector, int n, int k){
+    nthElement(vector, 0, n - 1, k, DefaultComparator<ITEM>());
+}
+
+// the k smallest items in order at the start, the others after them in
+// no particular order, O(n + k lg k)
+template<typename ITEM, typename COMPARATOR>
+void partialSort(ITEM* vector, int left, int right, int k, COMPARATOR const& c,
+    Random<>& random = GlobalRNG()){
+    assert(0 <= k && k <= right - left + 1);
+    if(k == 0) return;
+    if(k < right - left + 1){
+        nthElement(vector, left, right, left + k - 1, c, random);
+        --k; // the last one is in place
+    }
+    pdqSort(vector, left, left + k - 1, c);
+}
+
+template<typename ITEM> void partialSort(ITEM* vector, int n, int k){
+    partialSort(vector, 0, n - 1, k, DefaultComparator<ITEM>());
+}
+
+// Keeps the k smallest of a stream of items in a max heap of k, so each
+// item costs a compare with the largest kept one and at most lg k more.
+// Accumulators of separate streams can be merged. For the largest use a
+// ReverseComparator.
+template<typename ITEM, typename COMPARATOR = DefaultComparator<ITEM> >
+class TopK{
+    COMPARATOR c;
+    int k;
+    Vector<ITEM> heap; // unordered until k items arrived
+public:
+    TopK(int theK, COMPARATOR const& theC = COMPARATOR()): c(theC), k(theK)
+        {assert(k >= 0);}
+
+    int getSize()const{return heap.getSize();}
+
+    void push(ITEM const& item){
+        if(heap.getSize() < k){
+            heap.append(item);
+            if(heap.getSize() == k)
+                for(int i = k / 2 - 1; i >= 0; --i) siftDown(heap.getArray(), i, k, c);
+        }
+        else if(k > 0 && c(item, heap[0])){
+            heap[0] = item;
+            siftDown(heap.getArray(), 0, k, c);
+        }
+    }
+
+    void merge(TopK const& other){
+        for(int i = 0; i < other.heap.getSize(); ++i) push(other.heap[i]);
+    }
+
+    // the kept items from the smallest
+    Vector<ITEM> getSorted()const{
+        Vector<ITEM> result = heap;
+        pdqSort(result.getArray(), 0, result.getSize() - 1, c);
+        return result;
+    }
+};
+
+// the k smallest items in order
+template<typename ITEM, typename COMPARATOR>
+Vector<ITEM> topK(ITEM const* vector, int n, int k, COMPARATOR const& c){
+    TopK<ITEM, COMPARATOR> result(k, c);
+    for(int i = 0; i < n; ++i) result.push(vector[i]);
+    return result.getSorted();
+}
+
+// each part of at least cutoff items goes to its own accumulator, which
+// are merged at the end
+template<typename ITEM, typename COMPARATOR>
+Vector<ITEM> topK(ITEM const* vector, int n, int k, COMPARATOR const& c,
+    ThreadPool& pool, int cutoff = 1 << 16){
+    int grain = std::max(cutoff, n / pool.getThreadCount() + 1);
+    Vector<TopK<ITEM, COMPARATOR> > parts((n + grain - 1) / grain, TopK<ITEM, COMPARATOR>(k, c));
+    parallelFor(pool, 0, n, grain, [&](long long i, long long j){
+        TopK<ITEM, COMPARATOR>& part = parts[i / grain];
+        for(; i < j; ++i) part.push(vector[i]);
+    });
+    TopK<ITEM, COMPARATOR> result(k, c);
+    for(int i = 0; i < parts.getSize(); ++i) result.merge(parts[i]);
+    return result.getSorted();
+}
+
+// for callers with many tiny arrays, a sorting network up to
+// SORTING_NETWORK_MAX items if the type has one
+template<typename ITEM, typename COMPARATOR>
+void sortSmall(ITEM* vector, int n, COMPARATOR const& c){
+    if(n > SORTING_NETWORK_MAX) pdqSort(vector, 0, n - 1, c);
+    else sortLeaf(vector, 0, n - 1, c);
+}
+
+template<typename ITEM> void sortSmall(ITEM* vector, int n){
+    sortSmall(vector, n, DefaultComparator<ITEM>());
+}
+
 template<typename ITEM, typename COMPARATOR>
 int binarySearch(ITEM const* vector, int left, int right,
                  ITEM const& key, COMPARATOR const& c){
@@ -111,7 +593,7 @@ void merge(ITEM* vector, int left, int middle, int right, COMPARATOR const& c, I
 
 template<typename ITEM, typename COMPARATOR>
 void mergeSortHelper(ITEM* vector, int left, int right, COMPARATOR const& c, ITEM* storage){
-    if(right - left > 16)
+    if(right - left >= 16)
     {
         // sort storage using vector as storage, then merge into vector
         int middle = (right + left) / 2;
@@ -119,7 +601,7 @@ void mergeSortHelper(ITEM* vector, int left, int right, COMPARATOR const& c, ITE
         mergeSortHelper(storage, middle + 1, right, c, vector);
         merge(vector, left, middle, right, c, storage);
     }
-    else insertionSort(vector, left, right, c);
+    else sortStableLeaf(vector, left, right, c);
 }
 
 template<typename ITEM, typename COMPARATOR>
@@ -130,6 +612,236 @@ void mergeSort(ITEM* vector, int n, COMPARATOR const& c){
     mergeSortHelper(vector, 0, n-1, c, storage.getArray());
 }
 
+template<typename ITEM, typename COMPARATOR>
+void mergeRanges(ITEM const* a, int na, ITEM const* b, int nb, ITEM* out, COMPARATOR const& c){
+    int i = 0, j = 0;
+    // ties go to a for stability
+    while(i < na && j < nb) *out++ = c(b[j], a[i]) ? b[j++] : a[i++];
+    while(i < na) *out++ = a[i++];
+    while(j < nb) *out++ = b[j++];
+}
+
+// number of items from a among the first k of the stable merge of a and b
+template<typename ITEM, typename COMPARATOR>
+int coRank(int k, ITEM const* a, int na, ITEM const* b, int nb, COMPARATOR const& c){
+    int low = std::max(0, k - nb), high = std::min(k, na);
+    while(low < high){
+        int i = low + (high - low) / 2, j = k - i;
+        // too few from a if a[i] goes before b[j - 1]
+        if(j > 0 && !c(b[j - 1], a[i])) low = i + 1;
+        else high = i;
+    }
+    return low;
+}
+
+// merge split into independent pieces of the output at co-ranks
+template<typename ITEM, typename COMPARATOR>
+void merge(ITEM* vector, int left, int middle, int right, COMPARATOR const& c,
+    ITEM* storage, ThreadPool& pool, int cutoff){
+    ITEM const *a = storage + left, *b = storage + middle + 1;
+    int na = middle - left + 1, nb = right - middle;
+    parallelFor(pool, 0, na + nb, cutoff, [=, &c](long long k0, long long k1){
+        int i0 = coRank(k0, a, na, b, nb, c), i1 = coRank(k1, a, na, b, nb, c);
+        mergeRanges(a + i0, i1 - i0, b + (k0 - i0), int(k1 - i1 - (k0 - i0)),
+            vector + left + k0, c);
+    });
+}
+
+template<typename ITEM, typename COMPARATOR>
+void mergeSortHelper(ITEM* vector, int left, int right, COMPARATOR const& c,
+    ITEM* storage, ThreadPool& pool, int cutoff){
+    if(right - left > cutoff){
+        // the same ping pong between the arrays as the sequential version
+        int middle = (right + left) / 2;
+        TaskGroup tasks(pool);
+        tasks.spawn([=, &c, &pool]{mergeSortHelper(storage, left, middle, c, vector, pool, cutoff);});
+        mergeSortHelper(storage, middle + 1, right, c, vector, pool, cutoff);
+        tasks.wait();
+        merge(vector, left, middle, right, c, storage, pool, cutoff);
+    }
+    else mergeSortHelper(vector, left, right, c, storage);
+}
+
+// parts of at most cutoff items are sorted and merged sequentially, the
+// result is the same as that of the sequential version
+template<typename ITEM, typename COMPARATOR>
+void mergeSort(ITEM* vector, int n, COMPARATOR const& c, ThreadPool& pool,
+    int cutoff = 1 << 13){
+    if(n <= 1) return;
+    cutoff = std::max(cutoff, 16);
+    ITEM* storage = rawMemory<ITEM>(n);
+    parallelFor(pool, 0, n, cutoff, [=](long long i, long long j)
+        {for(; i < j; ++i) new(&storage[i])ITEM(vector[i]);});
+    mergeSortHelper(vector, 0, n-1, c, storage, pool, cutoff);
+    rawDestruct(storage, n);
+}
+
+// Powersort, after Munro and Wild: a stable merge sort of the natural
+// runs of the input, so sorted, reversed and concatenated sorted inputs
+// take linear time. Runs shorter than MIN_RUN are extended by insertion
+// sort. Each boundary between runs gets a power, the depth of the node
+// that merges them in a merge tree balanced by length, and a stack of
+// runs with increasing powers merges them in that order. Merges skip the
+// prefix and suffix that are in place and gallop through long streaks
+// won by one side, as in TimSort.
+namespace power{
+    enum{MIN_RUN = 24, MIN_GALLOP = 7};
+
+    // number of leading i < n for which before(i) holds, a prefix, found
+    // by exponential then binary search
+    template<typename PREDICATE> int gallop(int n, PREDICATE const& before){
+        if(n == 0 || !before(0)) return 0;
+        int low = 1, high = 1; // before holds for [0, low)
+        while(high < n && before(high)){
+            low = high + 1;
+            high = 2 * high + 1;
+        }
+        high = std::min(high, n);
+        while(low < high){
+            int middle = low + (high - low) / 2;
+            if(before(middle)) low = middle + 1;
+            else high = middle;
+        }
+        return low;
+    }
+
+    // end of the run starting at begin, descending ones are reversed,
+    // strictly descending only to keep the sort stable
+    template<typename ITEM, typename COMPARATOR>
+    int extendRun(ITEM* vector, int begin, int n, COMPARATOR const& c){
+        int end = begin + 1;
+        if(end == n) return end;
+        if(c(vector[end], vector[begin])){
+            while(++end < n && c(vector[end], vector[end - 1]));
+            std::reverse(vector + begin, vector + end);
+        }
+        else while(++end < n && !c(vector[end], vector[end - 1]));
+        if(end - begin < MIN_RUN){
+            end = std::min(n, begin + MIN_RUN);
+            insertionSort(vector, begin, end - 1, c);
+        }
+        return end;
+    }
+
+    // leading common bits of the midpoints of the runs as fractions of n
+    inline int nodePower(int begin, int middle, int end, int n){
+        typedef unsigned __int128 Wide;
+        unsigned long long a = (unsigned long long)(((Wide)(begin + middle) << 62) / n),
+            b = (unsigned long long)(((Wide)(middle + end) << 62) / n);
+        return 63 - lgFloor(a ^ b);
+    }
+
+    // [left, middle) goes to the buffer and is merged from the front
+    template<typename ITEM, typename COMPARATOR>
+    void mergeLow(ITEM* vector, int left, int middle, int right, COMPARATOR const& c, ITEM* buffer){
+        int na = middle - left, i = 0, j = middle, k = left;
+        for(int x = 0; x < na; ++x) buffer[x] = std::move(vector[left + x]);
+        while(i < na && j < right){
+            // one at a time until a side wins MIN_GALLOP in a row
+            for(int winsA = 0, winsB = 0; i < na && j < right &&
+                winsA < MIN_GALLOP && winsB < MIN_GALLOP;){
+                if(c(vector[j], buffer[i])){
+                    vector[k++] = std::move(vector[j++]);
+                    ++winsB;
+                    winsA = 0;
+                }
+                else {
+                    vector[k++] = std::move(buffer[i++]);
+                    ++winsA;
+                    winsB = 0;
+                }
+            }
+            // then in streaks while they are long
+            for(int streak = MIN_GALLOP; streak >= MIN_GALLOP && i < na && j < right;){
+                streak = gallop(na - i, [&](int x){return !c(vector[j], buffer[i + x]);});
+                for(int x = 0; x < streak; ++x) vector[k++] = std::move(buffer[i++]);
+                if(i == na) break;
+                int streakB = gallop(right - j, [&](int x){return c(vector[j + x], buffer[i]);});
+                for(int x = 0; x < streakB; ++x) vector[k++] = std::move(vector[j++]);
+                streak = std::max(streak, streakB);
+            }
+        }
+        // the rest of [middle, right) is in place
+        while(i < na) vector[k++] = std::move(buffer[i++]);
+    }
+
+    // [middle, right) goes to the buffer and is merged from the back
+    template<typename ITEM, typename COMPARATOR>
+    void mergeHigh(ITEM* vector, int left, int middle, int right, COMPARATOR const& c, ITEM* buffer){
+        int nb = right - middle, i = middle - 1, j = nb - 1, k = right - 1;
+        for(int x = 0; x < nb; ++x) buffer[x] = std::move(vector[middle + x]);
+        while(i >= left && j >= 0){
+            for(int winsA = 0, winsB = 0; i >= left && j >= 0 &&
+                winsA < MIN_GALLOP && winsB < MIN_GALLOP;){
+                if(c(buffer[j], vector[i])){
+                    vector[k--] = std::move(vector[i--]);
+                    ++winsA;
+                    winsB = 0;
+                }
+                else {
+                    vector[k--] = std::move(buffer[j--]);
+                    ++winsB;
+                    winsA = 0;
+                }
+            }
+            for(int streak = MIN_GALLOP; streak >= MIN_GALLOP && i >= left && j >= 0;){
+                streak = gallop(j + 1, [&](int x){return !c(buffer[j - x], vector[i]);});
+                for(int x = 0; x < streak; ++x) vector[k--] = std::move(buffer[j--]);
+                if(j < 0) break;
+                int streakA = gallop(i - left + 1, [&](int x){return c(buffer[j], vector[i - x]);});
+                for(int x = 0; x < streakA; ++x) vector[k--] = std::move(vector[i--]);
+                streak = std::max(streak, streakA);
+            }
+        }
+        // the rest of [left, middle) is in place
+        while(j >= 0) vector[k--] = std::move(buffer[j--]);
+    }
+
+    template<typename ITEM, typename COMPARATOR>
+    void merge(ITEM* vector, int left, int middle, int right, COMPARATOR const& c, ITEM* buffer){
+        // items of the left run not after the first of the right one and
+        // items of the right run before the last of the left one stay
+        left += gallop(middle - left, [&](int x){return !c(vector[middle], vector[left + x]);});
+        if(left == middle) return;
+        right = middle + gallop(right - middle,
+            [&](int x){return c(vector[middle + x], vector[middle - 1]);});
+        if(middle - left <= right - middle) mergeLow(vector, left, middle, right, c, buffer);
+        else mergeHigh(vector, left, middle, right, c, buffer);
+    }
+}
+
+// scratch is grown to n / 2 items and can be reused to not allocate
+template<typename ITEM, typename COMPARATOR>
+void powerSort(ITEM* vector, int n, COMPARATOR const& c, Vector<ITEM>& scratch){
+    if(n < 2) return;
+    while(scratch.getSize() < n / 2) scratch.append(vector[0]);
+    // runs on the stack end where the next one begins
+    int begins[64], powers[64], top = 0,
+        begin = 0, end = power::extendRun(vector, 0, n, c);
+    while(end < n){
+        int nextEnd = power::extendRun(vector, end, n, c),
+            p = power::nodePower(begin, end, nextEnd, n);
+        for(; top > 0 && powers[top - 1] > p; begin = begins[--top])
+            power::merge(vector, begins[top - 1], begin, end, c, scratch.getArray());
+        begins[top] = begin;
+        powers[top++] = p;
+        begin = end;
+        end = nextEnd;
+    }
+    for(; top > 0; begin = begins[--top])
+        power::merge(vector, begins[top - 1], begin, n, c, scratch.getArray());
+}
+
+template<typename ITEM, typename COMPARATOR>
+void powerSort(ITEM* vector, int n, COMPARATOR const& c){
+    Vector<ITEM> scratch;
+    powerSort(vector, n, c, scratch);
+}
+
+template<typename ITEM> void powerSort(ITEM* vector, int n){
+    powerSort(vector, n, DefaultComparator<ITEM>());
+}
+
 void countingSort(int* vector, int n, int N);
 
 template<typename ITEM, typename ORDERED_HASH>
@@ -141,9 +853,397 @@ void KSort(ITEM* a, int n, int N, ORDERED_HASH const& h){
     // rearrange items
     for (int i = 0; i < n; ++i) new(&temp[prec[h(a[i])]++]) ITEM(a[i]);
     for (int i = 0; i < n; ++i) a[i] = temp[i];
-    rawDelete(temp);
+    rawDestruct(temp, n);
+}
+
+// Maps keys to unsigned words of the same order: signed integers get
+// their sign bit flipped, negative floats all bits, others the sign bit.
+// -0.0 comes before 0.0 and negative NaNs before everything.
+template<typename KEY, typename ENABLE = void> struct OrderedBits;
+template<typename KEY> struct OrderedBits<KEY,
+    typename std::enable_if<std::is_integral<KEY>::value>::type>{
+    typedef typename std::make_unsigned<KEY>::type Word;
+    static Word transform(KEY key){
+        Word sign = std::is_signed<KEY>::value ? Word(1) << (sizeof(Word) * 8 - 1) : 0;
+        return Word(key) ^ sign;
+    }
+};
+template<typename KEY> struct OrderedBits<KEY,
+    typename std::enable_if<std::is_floating_point<KEY>::value>::type>{
+    typedef typename std::conditional<sizeof(KEY) == 4, uint32_t, uint64_t>::type Word;
+    static Word transform(KEY key){
+        static_assert(sizeof(KEY) == sizeof(Word), "32 or 64 bit floats only");
+        Word bits;
+        std::memcpy(&bits, &key, sizeof(bits));
+        Word sign = Word(1) << (sizeof(Word) * 8 - 1);
+        return bits & sign ? ~bits : bits | sign;
+    }
+};
+
+template<typename ITEM> struct IdentityKey{
+    ITEM const& operator()(ITEM const& item)const{return item;}
+};
+
+// Stable LSD radix sort of items by an integer or floating point key,
+// with up to 11 bit digits. Histograms of all digits are made in one
+// read, and passes where all items have the same digit are skipped. The
+// scratch buffer and counters are kept for the next sort.
+template<typename ITEM, typename KEY_FUNCTION = IdentityKey<ITEM> >
+class RadixSorter{
+    typedef typename std::decay<decltype(std::declval<KEY_FUNCTION const&>()(
+        std::declval<ITEM const&>()))>::type Key;
+    typedef typename OrderedBits<Key>::Word Word;
+    enum{WORD_BITS = sizeof(Word) * 8, MAX_DIGIT_BITS = 11, SMALL_DIGIT_BITS = 8,
+        SMALL_SIZE = 1 << 12, MIN_PARALLEL_SIZE = 1 << 16};
+    KEY_FUNCTION key;
+    Vector<ITEM> scratch;
+    Vector<int> counts, chunkCounts;
+    int digitBits, passes;
+
+    Word bits(ITEM const& item)const{return OrderedBits<Key>::transform(key(item));}
+    int digit(Word w, int pass)const
+        {return int((w >> (pass * digitBits)) & ((Word(1) << digitBits) - 1));}
+
+    ITEM* prepare(ITEM const* vector, int n, Vector<int>& table, int tables){
+        // fewer passes for large inputs, smaller tables for small ones
+        passes = ceiling(WORD_BITS, n < SMALL_SIZE ? SMALL_DIGIT_BITS : MAX_DIGIT_BITS);
+        digitBits = ceiling(WORD_BITS, passes);
+        if(table.getSize() < tables * (passes << digitBits))
+            table = Vector<int>(tables * (passes << digitBits), 0);
+        if(scratch.getSize() < n) scratch = Vector<ITEM>(n, vector[0]);
+        return scratch.getArray();
+    }
+
+    void countAll(ITEM const* vector, int n, int* c)const{
+        int radix = 1 << digitBits;
+        for(int i = 0; i < passes * radix; ++i) c[i] = 0;
+        for(int i = 0; i < n; ++i){
+            Word w = bits(vector[i]);
+            for(int p = 0; p < passes; ++p) ++c[p * radix + digit(w, p)];
+        }
+    }
+
+public:
+    RadixSorter(KEY_FUNCTION const& theKey = KEY_FUNCTION()): key(theKey),
+        digitBits(0), passes(0) {}
+
+    void sort(ITEM* vector, int n){
+        if(n <= 1) return;
+        ITEM *from = vector, *to = prepare(vector, n, counts, 1);
+        int radix = 1 << digitBits;
+        countAll(vector, n, counts.getArray());
+        for(int p = 0; p < passes; ++p){
+            int* c = counts.getArray() + p * radix;
+            if(c[digit(bits(from[0]), p)] == n) continue; // all the same
+            for(int d = 0, total = 0; d < radix; ++d){
+                int count = c[d];
+                c[d] = total;
+                total += count;
+            }
+            for(int i = 0; i < n; ++i) to[c[digit(bits(from[i]), p)]++] = from[i];
+            std::swap(from, to);
+        }
+        if(from != vector) for(int i = 0; i < n; ++i) vector[i] = from[i];
+    }
+
+    // every thread counts and scatters a contiguous chunk, offsets of
+    // equal digits are assigned in chunk order to stay stable
+    void sort(ITEM* vector, int n, ThreadPool& pool){
+        int chunks = pool.getThreadCount();
+        if(chunks == 1 || n < MIN_PARALLEL_SIZE){
+            sort(vector, n);
+            return;
+        }
+        ITEM *from = vector, *to = prepare(vector, n, chunkCounts, chunks);
+        int radix = 1 << digitBits, tableSize = passes * radix;
+        auto chunkStart = [n, chunks](int t){return int((long long)n * t / chunks);};
+        parallelFor(pool, 0, chunks, 1, [&](long long t, long long){
+            countAll(vector + chunkStart(t), chunkStart(t + 1) - chunkStart(t),
+                chunkCounts.getArray() + t * tableSize);
+        });
+        bool moved = false;
+        for(int p = 0; p < passes; ++p){
+            int total = 0;
+            for(int t = 0; t < chunks; ++t)
+                total += chunkCounts[t * tableSize + p * radix + digit(bits(from[0]), p)];
+            if(total == n) continue; // all the same
+            if(moved) parallelFor(pool, 0, chunks, 1, [&](long long t, long long){
+                // counts of the current order, only this pass is needed
+                int* c = chunkCounts.getArray() + t * tableSize + p * radix;
+                for(int d = 0; d < radix; ++d) c[d] = 0;
+                for(int i = chunkStart(t); i < chunkStart(t + 1); ++i)
+                    ++c[digit(bits(from[i]), p)];
+            });
+            total = 0;
+            for(int d = 0; d < radix; ++d)
+                for(int t = 0; t < chunks; ++t){
+                    int* c = chunkCounts.getArray() + t * tableSize + p * radix + d,
+                        count = *c;
+                    *c = total;
+                    total += count;
+                }
+            parallelFor(pool, 0, chunks, 1, [&](long long t, long long){
+                int* c = chunkCounts.getArray() + t * tableSize + p * radix;
+                for(int i = chunkStart(t); i < chunkStart(t + 1); ++i)
+                    to[c[digit(bits(from[i]), p)]++] = from[i];
+            });
+            std::swap(from, to);
+            moved = true;
+        }
+        if(from != vector) parallelFor(pool, 0, n, MIN_PARALLEL_SIZE,
+            [=](long long i, long long j){for(; i < j; ++i) vector[i] = from[i];});
+    }
+};
+
+template<typename ITEM> void radixSort(ITEM* vector, int n){
+    RadixSorter<ITEM>().sort(vector, n);
 }
+template<typename ITEM, typename KEY_FUNCTION>
+void radixSort(ITEM* vector, int n, KEY_FUNCTION const& key){
+    RadixSorter<ITEM, KEY_FUNCTION>(key).sort(vector, n);
+}
+
+template<typename KEY> struct KeyIndexKey{
+    KEY const& operator()(std::pair<KEY, int> const& item)const{return item.first;}
+};
+
+// Positions of the items in stably sorted order by key(item). The keys
+// are extracted with their positions first, so the sort reads compact
+// pairs instead of the items at random, and radix sorted if integer or
+// floating point. Reorder the items with applyPermutation.
+template<typename ITEM, typename KEY_FUNCTION>
+Vector<int> argSort(ITEM const* vector, int n, KEY_FUNCTION const& key){
+    typedef typename std::decay<decltype(key(vector[0]))>::type Key;
+    typedef std::pair<Key, int> KeyIndex;
+    Vector<KeyIndex> pairs;
+    pairs.reserve(n);
+    for(int i = 0; i < n; ++i) pairs.append(KeyIndex(key(vector[i]), i));
+    if constexpr((std::is_integral<Key>::value && !std::is_same<Key, bool>::value) ||
+        (std::is_floating_point<Key>::value && sizeof(Key) <= 8))
+        RadixSorter<KeyIndex, KeyIndexKey<Key> >().sort(pairs.getArray(), n);
+    else powerSort(pairs.getArray(), n, PairFirstComparator<Key, int>());
+    Vector<int> result(n);
+    for(int i = 0; i < n; ++i) result[i] = pairs[i].second;
+    return result;
+}
+
+template<typename ITEM> Vector<int> argSort(ITEM const* vector, int n){
+    return argSort(vector, n, IdentityKey<ITEM>());
+}
+
+// vector[i] becomes vector[permutation[i]], in place by following the
+// cycles of the permutation, so every item is moved once and a cycle
+// needs one temporary. The permutation is marked while it is followed
+// and restored afterwards.
+template<typename ITEM>
+void applyPermutation(ITEM* vector, int n, int* permutation){
+    for(int start = 0; start < n; ++start){
+        if(permutation[start] < 0) continue; // done in an earlier cycle
+        ITEM item(std::move(vector[start]));
+        int i = start;
+        for(int next; (next = permutation[i]) != start; i = next){
+            assert(0 <= next && next < n);
+            vector[i] = std::move(vector[next]);
+            permutation[i] = ~next;
+        }
+        vector[i] = std::move(item);
+        permutation[i] = ~start;
+    }
+    for(int i = 0; i < n; ++i) permutation[i] = ~permutation[i];
+}
+
+// Sorts of keys compared item by item, as with LexicographicComparator.
+// The next items of the keys are read into a cache next to them, packed
+// several to a word, so partitioning and bucketing scan an array instead
+// of following every key, and a common prefix is passed over once.
+namespace strings{
+    enum{SMALL = 16, RADIX = 257, MIN_RADIX_SIZE = 1 << 10};
+    typedef unsigned long long Word;
 
+    // SIZE items from depth in the high bits, in order, and in the low
+    // byte how many of them the key has. Words compare like the keys over
+    // the window, and an equal word of a count below the window ended.
+    template<typename COMPARATOR> struct Window{
+        enum{BITS = COMPARATOR::CHARACTER_BITS, SIZE = 56 / BITS};
+        static int count(Word w){return int(w & 0xFF);}
+        // the first item as a bucket, 0 if the key ended
+        static int first(Word w){return count(w) ? int(w >> (64 - BITS)) + 1 : 0;}
+        // drops the first item
+        static Word next(Word w){return ((w & ~Word(0xFF)) << BITS) | (count(w) - 1);}
+    };
+
+    template<typename ITEM, typename COMPARATOR>
+    Word pack(ITEM const& key, int depth, COMPARATOR const& c){
+        typedef Window<COMPARATOR> W;
+        Word result = 0;
+        int k = 0;
+        for(; k < W::SIZE; ++k){
+            Word item = c.getCharacter(key, depth + k);
+            if(!item) break;
+            result |= (item - 1) << (64 - W::BITS * (k + 1));
+        }
+        return result | k;
+    }
+
+    template<typename ITEM, typename COMPARATOR>
+    void fillCache(ITEM const* vector, int n, int depth, COMPARATOR const& c, Word* cache){
+        for(int i = 0; i < n; ++i) cache[i] = pack(vector[i], depth, c);
+    }
+
+    // whether a is less than b, both equal before depth
+    template<typename ITEM, typename COMPARATOR>
+    bool lessFrom(ITEM const& a, ITEM const& b, int depth, COMPARATOR const& c){
+        int size = std::min(c.getSize(a), c.getSize(b));
+        while(depth < size && c.isEqual(a, b, depth)) ++depth;
+        return c(a, b, depth);
+    }
+
+    template<typename ITEM>
+    void swapWithCache(ITEM* vector, Word* cache, int i, int j){
+        std::swap(vector[i], vector[j]);
+        std::swap(cache[i], cache[j]);
+    }
+
+    // by the cached words of valid items from depth, ties by the rest
+    template<typename ITEM, typename COMPARATOR>
+    void insertionSort(ITEM* vector, Word* cache, int n, int depth, int valid,
+        COMPARATOR const& c){
+        for(int i = 1; i < n; ++i){
+            Word w = cache[i];
+            auto before = [&](ITEM const& x, int j){return w < cache[j] || (w == cache[j] &&
+                Window<COMPARATOR>::count(w) == valid && lessFrom(x, vector[j], depth + valid, c));};
+            if(!before(vector[i], i - 1)) continue;
+            ITEM x(std::move(vector[i]));
+            int j = i;
+            for(; j > 0 && before(x, j - 1); --j){
+                vector[j] = std::move(vector[j - 1]);
+                cache[j] = cache[j - 1];
+            }
+            vector[j] = std::move(x);
+            cache[j] = w;
+        }
+    }
+
+    // keys equal before depth, the cache holds valid of their items from
+    // there, refilled when none are left
+    template<typename ITEM, typename COMPARATOR>
+    void multikey(ITEM* vector, Word* cache, int n, int depth, int valid,
+        COMPARATOR const& c, Random<>& random){
+        if(valid == 0){
+            fillCache(vector, n, depth, c, cache);
+            valid = Window<COMPARATOR>::SIZE;
+        }
+        while(n > SMALL){
+            Word a = cache[random.mod(n)], b = cache[random.mod(n)],
+                d = cache[random.mod(n)],
+                pivot = std::max(std::min(a, b), std::min(std::max(a, b), d));
+            // less in [0, lt), equal in [lt, i), greater in (gt, n)
+            int lt = 0, i = 0, gt = n - 1;
+            while(i <= gt){
+                if(cache[i] < pivot) swapWithCache(vector, cache, lt++, i++);
+                else if(pivot < cache[i]) swapWithCache(vector, cache, i, gt--);
+                else ++i;
+            }
+            multikey(vector, cache, lt, depth, valid, c, random);
+            multikey(vector + gt + 1, cache + gt + 1, n - gt - 1, depth, valid, c, random);
+            if(Window<COMPARATOR>::count(pivot) < valid) return; // the equal keys ended
+            vector += lt;
+            cache += lt;
+            n = gt + 1 - lt;
+            depth += valid;
+            valid = Window<COMPARATOR>::SIZE;
+            fillCache(vector, n, depth, c, cache);
+        }
+        insertionSort(vector, cache, n, depth, valid, c);
+    }
+
+    // American flag sort by the first cached item, buckets are permuted
+    // in place along cycles, the small ones are left to multikey. The
+    // largest bucket is sorted by the loop and only the others recurse,
+    // so the depth is at most lg n however long the keys are.
+    template<typename ITEM, typename COMPARATOR>
+    void msdRadix(ITEM* vector, Word* cache, int n, int depth, int valid,
+        COMPARATOR const& c, Random<>& random){
+        typedef Window<COMPARATOR> W;
+        static_assert(W::BITS == 8, "keys of bytes");
+        int count[RADIX], next[RADIX], end[RADIX];
+        while(n >= MIN_RADIX_SIZE){
+            for(;;){
+                if(valid == 0){
+                    fillCache(vector, n, depth, c, cache);
+                    valid = W::SIZE;
+                }
+                for(int d = 0; d < RADIX; ++d) count[d] = 0;
+                for(int i = 0; i < n; ++i) ++count[W::first(cache[i])];
+                int common = W::first(cache[0]);
+                if(count[common] < n) break;
+                if(common == 0) return; // all keys ended
+                for(int i = 0; i < n; ++i) cache[i] = W::next(cache[i]);
+                ++depth;
+                --valid;
+            }
+            for(int d = 0, total = 0; d < RADIX; ++d){
+                next[d] = total;
+                end[d] = total += count[d];
+            }
+            for(int d = 0; d < RADIX; ++d){
+                for(; next[d] < end[d]; ++next[d])
+                    for(int k; (k = W::first(cache[next[d]])) != d;)
+                        swapWithCache(vector, cache, next[d], next[k]++);
+            }
+            // keys of bucket 0 ended and are equal
+            int largest = 1;
+            for(int d = 2; d < RADIX; ++d) if(count[d] > count[largest]) largest = d;
+            for(int d = 1, start = count[0]; d < RADIX; start += count[d++]){
+                if(count[d] <= 1) continue;
+                for(int i = start; i < start + count[d]; ++i) cache[i] = W::next(cache[i]);
+                if(d == largest) continue;
+                if(count[d] < MIN_RADIX_SIZE) multikey(vector + start, cache + start,
+                    count[d], depth + 1, valid - 1, c, random);
+                else msdRadix(vector + start, cache + start, count[d], depth + 1, valid - 1,
+                    c, random);
+            }
+            int start = count[0];
+            for(int d = 1; d < largest; ++d) start += count[d];
+            vector += start;
+            cache += start;
+            n = count[largest];
+            ++depth;
+            --valid;
+            if(n <= 1) return;
+        }
+        multikey(vector, cache, n, depth, valid, c, random);
+    }
+}
+
+// Multikey quicksort, partitions three ways by the cached next items and
+// goes on past them in the equal part only. The comparator also gives
+// the items as numbers, see LexicographicComparator::getCharacter.
+template<typename ITEM, typename COMPARATOR>
+void multikeyQuickSort(ITEM* vector, int n, COMPARATOR const& c,
+    Random<>& random = GlobalRNG()){
+    if(n <= 1) return;
+    Vector<strings::Word> cache(n);
+    strings::multikey(vector, cache.getArray(), n, 0, 0, c, random);
+}
+template<typename ITEM> void multikeyQuickSort(ITEM* vector, int n){
+    multikeyQuickSort(vector, n, LexicographicComparator<ITEM>());
+}
+
+// MSD radix sort of keys of bytes, with a bucket per byte value and one
+// for the keys that ended, in place. Buckets of fewer than MIN_RADIX_SIZE
+// keys are finished by multikeyQuickSort.
+template<typename ITEM, typename COMPARATOR>
+void msdRadixSort(ITEM* vector, int n, COMPARATOR const& c,
+    Random<>& random = GlobalRNG()){
+    if(n <= 1) return;
+    Vector<strings::Word> cache(n);
+    if(n < strings::MIN_RADIX_SIZE) strings::multikey(vector, cache.getArray(), n, 0, 0, c, random);
+    else strings::msdRadix(vector, cache.getArray(), n, 0, 0, c, random);
+}
+template<typename ITEM> void msdRadixSort(ITEM* vector, int n){
+    msdRadixSort(vector, n, LexicographicComparator<ITEM>());
+}
 }
 
 #endif // SORTING_H
@@ -0,0 +1,237 @@
+#ifndef SORTINGNETWORK_H
+#define SORTINGNETWORK_H
+
+#include <algorithm>
+#include <type_traits>
+#include "utils.hpp"
+#include "bits.hpp"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace dmk{
+
+    // Registers of W items for the sorting network. exchange puts the
+    // smaller items of two registers in lo and exchangeInside does the
+    // same for the lanes i and i ^ partner of one, the smaller going to
+    // the lane without bit. Both only permute, so equal floats of
+    // different sign and NaNs are kept. W = 1 is the scalar fallback,
+    // which compiles to conditional moves for arithmetic types.
+    template<typename ITEM, typename ENABLE = void> struct NetworkLanes{
+        enum{W = 1};
+        typedef ITEM V;
+        static V load(ITEM const* p){return *p;}
+        static void store(ITEM* p, V const& x){*p = x;}
+        static V reverse(V const& x){return x;}
+        static void exchange(V& lo, V& hi){
+            bool swap = hi < lo;
+            V x = lo;
+            lo = swap ? hi : lo;
+            hi = swap ? x : hi;
+        }
+        static V exchangeInside(V const& x, int, int){return x;}
+    };
+
+#ifdef __AVX2__
+    // lane index and mask vectors for items of SIZE bytes in 32 bit lanes
+    template<int SIZE> struct AvxLanes{
+        enum{W = 32 / SIZE};
+        static __m256i partners(int m){
+            if(SIZE == 4) return _mm256_setr_epi32(0 ^ m, 1 ^ m, 2 ^ m, 3 ^ m,
+                4 ^ m, 5 ^ m, 6 ^ m, 7 ^ m);
+            return _mm256_setr_epi32(2 * (0 ^ m), 2 * (0 ^ m) + 1, 2 * (1 ^ m),
+                2 * (1 ^ m) + 1, 2 * (2 ^ m), 2 * (2 ^ m) + 1, 2 * (3 ^ m), 2 * (3 ^ m) + 1);
+        }
+        // all ones in the lanes with bit
+        static __m256i upper(int bit){
+            if(SIZE == 4) return _mm256_setr_epi32(-!!(0 & bit), -!!(1 & bit),
+                -!!(2 & bit), -!!(3 & bit), -!!(4 & bit), -!!(5 & bit),
+                -!!(6 & bit), -!!(7 & bit));
+            return _mm256_setr_epi64x(-!!(0 & bit), -!!(1 & bit), -!!(2 & bit), -!!(3 & bit));
+        }
+        static __m256i permute(__m256i x, int m)
+            {return _mm256_permutevar8x32_epi32(x, partners(m));}
+    };
+
+    template<typename ITEM> struct NetworkLanes<ITEM, typename std::enable_if<
+        std::is_integral<ITEM>::value && sizeof(ITEM) == 4>::type>: AvxLanes<4>{
+        typedef __m256i V;
+        static V load(ITEM const* p){return _mm256_loadu_si256((V const*)p);}
+        static void store(ITEM* p, V x){_mm256_storeu_si256((V*)p, x);}
+        static V reverse(V x){return permute(x, W - 1);}
+        static V minimum(V a, V b)
+            {return std::is_signed<ITEM>::value ? _mm256_min_epi32(a, b) : _mm256_min_epu32(a, b);}
+        static V maximum(V a, V b)
+            {return std::is_signed<ITEM>::value ? _mm256_max_epi32(a, b) : _mm256_max_epu32(a, b);}
+        static void exchange(V& lo, V& hi){
+            V x = lo;
+            lo = minimum(x, hi);
+            hi = maximum(x, hi);
+        }
+        static V exchangeInside(V x, int partner, int bit){
+            V p = permute(x, partner);
+            return _mm256_blendv_epi8(minimum(x, p), maximum(x, p), upper(bit));
+        }
+    };
+
+    template<typename ITEM> struct NetworkLanes<ITEM, typename std::enable_if<
+        std::is_integral<ITEM>::value && sizeof(ITEM) == 8>::type>: AvxLanes<8>{
+        typedef __m256i V;
+        static V load(ITEM const* p){return _mm256_loadu_si256((V const*)p);}
+        static void store(ITEM* p, V x){_mm256_storeu_si256((V*)p, x);}
+        static V reverse(V x){return permute(x, W - 1);}
+        // no 64 bit min and max, unsigned compares are signed ones with
+        // the top bit flipped
+        static V greater(V a, V b){
+            if(std::is_signed<ITEM>::value) return _mm256_cmpgt_epi64(a, b);
+            V top = _mm256_set1_epi64x(0x8000000000000000ll);
+            return _mm256_cmpgt_epi64(_mm256_xor_si256(a, top), _mm256_xor_si256(b, top));
+        }
+        static void exchange(V& lo, V& hi){
+            V x = lo, swap = greater(x, hi);
+            lo = _mm256_blendv_epi8(x, hi, swap);
+            hi = _mm256_blendv_epi8(hi, x, swap);
+        }
+        static V exchangeInside(V x, int partner, int bit){
+            V p = permute(x, partner), swap = greater(x, p);
+            return _mm256_blendv_epi8(_mm256_blendv_epi8(x, p, swap),
+                _mm256_blendv_epi8(p, x, swap), upper(bit));
+        }
+    };
+
+    template<> struct NetworkLanes<float>: AvxLanes<4>{
+        typedef __m256 V;
+        static V load(float const* p){return _mm256_loadu_ps(p);}
+        static void store(float* p, V x){_mm256_storeu_ps(p, x);}
+        static V permute(V x, int m){return _mm256_permutevar8x32_ps(x, partners(m));}
+        static V reverse(V x){return permute(x, W - 1);}
+        // both return the second operand if not ordered
+        static void exchange(V& lo, V& hi){
+            V x = lo;
+            lo = _mm256_min_ps(x, hi);
+            hi = _mm256_max_ps(hi, x);
+        }
+        static V exchangeInside(V x, int partner, int bit){
+            V p = permute(x, partner);
+            return _mm256_blendv_ps(_mm256_min_ps(x, p), _mm256_max_ps(x, p),
+                _mm256_castsi256_ps(upper(bit)));
+        }
+    };
+
+    template<> struct NetworkLanes<double>: AvxLanes<8>{
+        typedef __m256d V;
+        static V load(double const* p){return _mm256_loadu_pd(p);}
+        static void store(double* p, V x){_mm256_storeu_pd(p, x);}
+        static V permute(V x, int m){return _mm256_castsi256_pd(
+            AvxLanes<8>::permute(_mm256_castpd_si256(x), m));}
+        static V reverse(V x){return permute(x, W - 1);}
+        static void exchange(V& lo, V& hi){
+            V x = lo;
+            lo = _mm256_min_pd(x, hi);
+            hi = _mm256_max_pd(hi, x);
+        }
+        static V exchangeInside(V x, int partner, int bit){
+            V p = permute(x, partner);
+            return _mm256_blendv_pd(_mm256_min_pd(x, p), _mm256_max_pd(x, p),
+                _mm256_castsi256_pd(upper(bit)));
+        }
+    };
+#endif
+
+    // The recursive sorts and sortSmall use networks where they have SIMD
+    // lanes, the scalar ones lose to insertionSort beyond about 8 items.
+    template<typename ITEM, typename COMPARATOR> struct HasSortingNetwork{
+        enum{value = NetworkLanes<ITEM>::W > 1 &&
+            std::is_same<COMPARATOR, DefaultComparator<ITEM> >::value};
+    };
+    // Equal integers are the same, so the network keeps mergeSort stable.
+    // Equal floats are not, the min and max lanes may swap +0 and -0.
+    template<typename ITEM, typename COMPARATOR> struct HasStableSortingNetwork{
+        enum{value = HasSortingNetwork<ITEM, COMPARATOR>::value &&
+            std::is_integral<ITEM>::value};
+    };
+
+    // Bitonic sort of N items, a power of two at least W. Each merge of
+    // two sorted halves of a k block compares the items mirrored around
+    // its middle, then in halves of j = k / 4 down to 1. Distances of at
+    // least W pair whole registers, shorter ones lanes of one register.
+    template<int N, typename ITEM> void bitonicSort(ITEM* vector){
+        typedef NetworkLanes<ITEM> L;
+        enum{W = L::W, R = N / W};
+        static_assert(N >= W && N % W == 0, "at least a register of items");
+        typename L::V r[R];
+#pragma GCC unroll 16
+        for(int i = 0; i < R; ++i) r[i] = L::load(vector + i * W);
+#pragma GCC unroll 8
+        for(int k = 2; k <= N; k *= 2){
+            if(k <= W){
+#pragma GCC unroll 16
+                for(int i = 0; i < R; ++i) r[i] = L::exchangeInside(r[i], k - 1, k / 2);
+            }
+            else {
+                // pairs t of blocks of half registers
+                int half = k / W / 2;
+#pragma GCC unroll 16
+                for(int t = 0; t < R / 2; ++t){
+                    int lo = t / half * 2 * half + t % half, hi = lo + 2 * (half - t % half) - 1;
+                    typename L::V mirror = L::reverse(r[hi]);
+                    L::exchange(r[lo], mirror);
+                    r[hi] = L::reverse(mirror);
+                }
+            }
+#pragma GCC unroll 8
+            for(int j = k / 4; j > 0; j /= 2){
+                if(j < W){
+#pragma GCC unroll 16
+                    for(int i = 0; i < R; ++i) r[i] = L::exchangeInside(r[i], j, j);
+                }
+                else {
+                    int half = j / W;
+#pragma GCC unroll 16
+                    for(int t = 0; t < R / 2; ++t){
+                        int lo = t / half * 2 * half + t % half;
+                        L::exchange(r[lo], r[lo + half]);
+                    }
+                }
+            }
+        }
+#pragma GCC unroll 16
+        for(int i = 0; i < R; ++i) L::store(vector + i * W, r[i]);
+    }
+
+    enum{SORTING_NETWORK_MAX = 64};
+
+    // sorts n <= SORTING_NETWORK_MAX items with the network of the next
+    // power of two, padded with copies of the largest item, any type with
+    // operator< works
+    template<typename ITEM> void networkSort(ITEM* vector, int n){
+        assert(n <= SORTING_NETWORK_MAX);
+        if(n <= 1) return;
+        enum{W = NetworkLanes<ITEM>::W};
+        int size = std::max<int>(W, nextPowerOfTwo(n));
+        ITEM buffer[SORTING_NETWORK_MAX];
+        ITEM* items = vector;
+        if(size != n){
+            ITEM largest = vector[0];
+            for(int i = 0; i < n; ++i){
+                buffer[i] = vector[i];
+                if(largest < vector[i]) largest = vector[i];
+            }
+            for(int i = n; i < size; ++i) buffer[i] = largest;
+            items = buffer;
+        }
+        switch(size){
+            // never smaller than W
+            case 2: bitonicSort<std::max<int>(W, 2)>(items); break;
+            case 4: bitonicSort<std::max<int>(W, 4)>(items); break;
+            case 8: bitonicSort<8>(items); break;
+            case 16: bitonicSort<16>(items); break;
+            case 32: bitonicSort<32>(items); break;
+            default: bitonicSort<64>(items);
+        }
+        if(items != vector) for(int i = 0; i < n; ++i) vector[i] = buffer[i];
+    }
+
+}
+
+#endif // SORTINGNETWORK_H
@@ -4,19 +4,115 @@
 
 #include "utils.hpp"
 #include "vector.hpp"
+#include "smallvector.hpp"
 #include "sorting.hpp"
+#include "parallel.hpp"
+#include "bits.hpp"
 #include <cassert>
 #include <algorithm>
 #include <cmath>
 
 namespace dmk{
 
+// Sums by row of scaled sparse columns, one result column at a time, for
+// products. Columns expecting many products for the rows add into a
+// dense array, the others into a linear probing hash table of at least
+// twice the products, which stays in cache. Rows and slots are marked
+// with the column that used them last, so neither is ever cleared, and
+// the rows are kept in order of arrival, so the exact size of the column
+// is known before it is extracted.
+template<typename ITEM> class SparseAccumulator{
+    enum{DENSE_RATIO = 16};
+    int rows, column, count, mask, shift;
+    bool isDense;
+    Vector<ITEM> dense;
+    Vector<int> marks; // column that last added to a row
+    Vector<int> keys, stamps; // the hash table and its marks
+    Vector<ITEM> values;
+    Vector<int> touched;
+
+    int find(int row)const{
+        int i = int((unsigned(row) * 2654435769u) >> shift);
+        while(stamps[i] == column && keys[i] != row) i = (i + 1) & mask;
+        return i;
+    }
+public:
+    explicit SparseAccumulator(int theRows): rows(theRows), column(-1), count(0),
+        mask(0), shift(0), isDense(false) {}
+
+    // products bounds the additions to the column
+    void start(long long products){
+        ++column;
+        count = 0;
+        isDense = products * DENSE_RATIO >= rows;
+        int need = int(std::min<long long>(products, rows));
+        if(touched.getSize() < need) touched = Vector<int>(need);
+        if(isDense){
+            if(marks.getSize() == 0){
+                marks = Vector<int>(rows, -1);
+                dense = Vector<ITEM>(rows);
+            }
+        }
+        else {
+            int bits = std::max(1, lgCeiling(2 * std::max(1, need)));
+            if(keys.getSize() < (1 << bits)){
+                keys = Vector<int>(1 << bits);
+                stamps = Vector<int>(1 << bits, -1);
+                values = Vector<ITEM>(1 << bits);
+            }
+            mask = (1 << bits) - 1;
+            shift = 32 - bits;
+        }
+    }
+
+    void add(int row, ITEM const& value){
+        if(isDense){
+            if(marks[row] != column){
+                marks[row] = column;
+                dense[row] = value;
+                touched[count++] = row;
+            }
+            else dense[row] += value;
+        }
+        else {
+            int i = find(row);
+            if(stamps[i] != column){
+                stamps[i] = column;
+                keys[i] = row;
+                values[i] = value;
+                touched[count++] = row;
+            }
+            else values[i] += value;
+        }
+    }
+
+    // rows added to since start
+    int getSize()const{return count;}
+
+    // calls out(row, sum) for the nonzero sums by row
+    template<typename FUNCTION> void extract(FUNCTION const& out){
+        if(isDense && count * 8 >= rows){
+            // scanning all rows is cheaper than sorting many
+            for(int row = 0; row < rows; ++row)
+                if(marks[row] == column && dense[row] != 0) out(row, dense[row]);
+            return;
+        }
+        if(count > 1) pdqSort(touched.getArray(), 0, count - 1, DefaultComparator<int>());
+        for(int i = 0; i < count; ++i){
+            int row = touched[i];
+            ITEM const& sum = isDense ? dense[row] : values[find(row)];
+            if(sum != 0) out(row, sum);
+        }
+    }
+};
+
 template<typename ITEM = double>
 class SparseMatrix: public ArithmeticType<SparseMatrix<ITEM> >
 {
 public:
     typedef std::pair<int, ITEM> Item;
-    typedef Vector<Item> SparseVector;
+    // most columns hold few items, so empty ones don't allocate
+    typedef SmallVector<Item, 1> SparseVector;
 private:
     int rows;
     Vector<SparseVector> itemColumns;
@@ -36,7 +132,7 @@ public:
 
     void growRight(int cols){
         for (int i = 0; i<cols; ++i)
-            itemColumns.append(SparseVector(rows));
+            itemColumns.append(SparseVector());
     }
 
     void growLeft(int cols){
@@ -63,6 +159,12 @@ public:
         return itemColumns[c];
     }
 
+    // replaces column c with items in order of row
+    void setColumn(int c, SparseVector column){
+        assert(column.getSize() == 0 || (column[0].first >= 0 && column.lastItem().first < rows));
+        itemColumns[c] = std::move(column);
+    }
+
     ITEM operator()(int r, int c)const
     { //absent entries are 0
         int position = findPosition(r, c);
@@ -187,26 +289,50 @@ public:
         return result;
     }
 
-    friend SparseVector operator*(SparseMatrix const& A, SparseVector const& v)
-        {return v * A.transpose();}
+    friend SparseVector operator*(SparseMatrix const& A, SparseVector const& v){
+        // columns scaled by the items of v, summed as in multiply
+        assert(v.getSize() == 0 || v.lastItem().first < A.getColumns());
+        SparseVector result;
+        SparseAccumulator<ITEM> accumulator(A.rows);
+        productColumn(A, v, accumulator, result);
+        return result;
+    }
 
-    friend Vector<ITEM> operator*(Vector<ITEM> const& v, SparseMatrix const& A)
-        {return sparseToDense(denseToSparse(v) * A, A.rows);}
+    friend Vector<ITEM> operator*(Vector<ITEM> const& v, SparseMatrix const& A){
+        // dot products of v with the columns
+        assert(v.getSize() == A.rows);
+        Vector<ITEM> result(A.getColumns(), ITEM(0));
+        for(int c = 0; c < A.getColumns(); ++c){
+            SparseVector const& column = A.itemColumns[c];
+            ITEM sum = 0;
+            for(int j = 0; j < column.getSize(); ++j) sum += column[j].second * v[column[j].first];
+            result[c] = sum;
+        }
+        return result;
+    }
 
-    friend Vector<ITEM> operator*(SparseMatrix const& A, Vector<ITEM> const& v)
-        {return sparseToDense(denseToSparse(v) * A, A.rows);}
+    friend Vector<ITEM> operator*(SparseMatrix const& A, Vector<ITEM> const& v){
+        // columns scaled by the items of v
+        assert(v.getSize() == A.getColumns());
+        Vector<ITEM> result(A.rows, ITEM(0));
+        for(int c = 0; c < A.getColumns(); ++c){
+            SparseVector const& column = A.itemColumns[c];
+            ITEM x = v[c];
+            if(x != 0) for(int j = 0; j < column.getSize(); ++j)
+                result[column[j].first] += column[j].second * x;
+        }
+        return result;
+    }
 
     friend double normInf(SparseMatrix const& A){
-        // first canlculate transpose for better iteration
-        SparseMatrix AT = A.transpose();
+        // largest absolute row sum, rows are spread over the columns
+        Vector<double> rowSums(A.getRows(), 0);
+        for(int c = 0; c < A.getColumns(); ++c)
+            for(int j = 0; j < A.itemColumns[c].getSize(); ++j)
+                rowSums[A.itemColumns[c][j].first] += std::abs(A.itemColumns[c][j].second);
         double maxRowSum = 0;
-        for (int r = 0; r < A.getRows(); r++) {
-            double rSum = 0;
-            for (int cj = 0; cj < AT.itemColumns[cj].getSize(); cj++) {
-               rSum += std::abs(AT.itemColumns[r][cj].second);
-            }
-            maxRowSum = std::max(maxRowSum, rSum);
-        }
+        for(int r = 0; r < A.getRows(); ++r) maxRowSum = std::max(maxRowSum, rowSums[r]);
+        return maxRowSum;
     }
 
     SparseMatrix transpose() const
@@ -221,41 +347,66 @@ public:
         return result;
     }
 
-    /*SparseMatrix& operator*=(SparseMatrix const& rhs){*/
-    /*    // O(n^2) * space factor() (1 to n)*/
-    /*    assert(getColumns() == rhs.rows);*/
-    /*    SparseMatrix result(rows, rhs.getColumns()), bT = rhs.transpose();*/
-    /*    typedef typename Key2DBuilder<>::WORD_TYPE W;*/
-    /*    LinearProbingHashTable<W, ITEM> outerSums;*/
-    /*    Key2DBuilder<> kb(std::max(result.rows, result.getColumns()),*/
-    /*                      result.rows >= result.getColumns());*/
-    /*    for (int k = 0; k < rhs.rows; ++k) {*/
-    /*        for (int aj = 0; aj < itemColumns[k].getSize(); ++aj) {*/
-    /*            for (int btj = 0; btj < bT.itemColumns[k].getSize(); ++btj) {*/
-    /*                int r = itemColumns[k][aj].first,*/
-    /*                    c = bT.itemColumns[k][btj].first;*/
-    /*                W key = kb.to1D(r, c);*/
-    /*                ITEM* rcSum = outerSums.find(key),*/
-    /*                      rcValue = itemColumns[k][aj].second * bT.itemColumns[k][btj];*/
-    /*                if(rcSum) *rcSum = rcValue;*/
-    /*                else outerSums.insert(key, rcValue);*/
-    /*            }*/
-    /*        }*/
-    /*    }*/
-    /*    // convert outer sum hash table into final data structure*/
-    /*    for(typename LinearProbingHashTable<W, ITEM>::Iterator iter =*/
-    /*        outerSums.begin(); iter != outerSums.end(); ++iter){*/
-    /*        // n must be the larger of r, c to make sense!*/
-    /*        std::pair<unsigned int, unsigned int> rc = kb.to2D(iter->key);*/
-    /*        result.itemColumns[rc.second].append(Item(rc.first, iter->value));*/
-    /*    }*/
-    /*    // sort each column to fix order*/
-    /*    for (int c = 0; c < result.getColumns(); ++c) quickSort(*/
-    /*        result.itemColumns[c].getArray(), 0,*/
-    /*        result.itemColumns[c].getSize() - 1,*/
-    /*        PairFirstComparator<int, ITEM>());*/
-    /*    return *this = result;*/
-    /*}*/
+    // Gustavson's product a * b, column j of the result is the sum of the
+    // columns k of a scaled by b(k, j). A symbolic pass over the structure
+    // of b bounds the products of every column, which picks its
+    // accumulator, and the accumulator gives the exact size of the column
+    // before it is written. Sums that cancel to 0 are not stored.
+    static SparseMatrix multiply(SparseMatrix const& a, SparseMatrix const& b){
+        assert(a.getColumns() == b.rows);
+        SparseMatrix result(a.rows, b.getColumns());
+        SparseAccumulator<ITEM> accumulator(a.rows);
+        for(int j = 0; j < b.getColumns(); ++j)
+            productColumn(a, b.itemColumns[j], accumulator, result.itemColumns[j]);
+        return result;
+    }
+
+    // the same with output columns split across the threads into ranges
+    // of about the same number of products
+    static SparseMatrix multiply(SparseMatrix const& a, SparseMatrix const& b,
+        ThreadPool& pool){
+        assert(a.getColumns() == b.rows);
+        int columns = b.getColumns(), parts = pool.getThreadCount();
+        SparseMatrix result(a.rows, columns);
+        Vector<long long> work(columns + 1, 0); // products before each column
+        for(int j = 0; j < columns; ++j) work[j + 1] = work[j] + a.countProducts(b.itemColumns[j]);
+        Vector<int> bounds(parts + 1, columns);
+        bounds[0] = 0;
+        for(int p = 1, j = 0; p < parts; ++p){
+            while(j < columns && work[j] * parts < work[columns] * p) ++j;
+            bounds[p] = j;
+        }
+        parallelFor(pool, 0, parts, 1, [&](long long p, long long){
+            SparseAccumulator<ITEM> accumulator(a.rows);
+            for(int j = bounds[p]; j < bounds[p + 1]; ++j)
+                productColumn(a, b.itemColumns[j], accumulator, result.itemColumns[j]);
+        });
+        return result;
+    }
+
+    SparseMatrix& operator*=(SparseMatrix const& rhs){return *this = multiply(*this, rhs);}
+
+private:
+    long long countProducts(SparseVector const& column)const{
+        long long result = 0;
+        for(int i = 0; i < column.getSize(); ++i) result += itemColumns[column[i].first].getSize();
+        return result;
+    }
+
+    static void productColumn(SparseMatrix const& a, SparseVector const& column,
+        SparseAccumulator<ITEM>& accumulator, SparseVector& result){
+        long long products = a.countProducts(column);
+        if(products == 0) return;
+        accumulator.start(products);
+        for(int i = 0; i < column.getSize(); ++i){
+            SparseVector const& scaled = a.itemColumns[column[i].first];
+            ITEM const& scale = column[i].second;
+            for(int t = 0; t < scaled.getSize(); ++t)
+                accumulator.add(scaled[t].first, scaled[t].second * scale);
+        }
+        result.reserve(accumulator.getSize());
+        accumulator.extract([&](int row, ITEM const& sum){result.append(Item(row, sum));});
+    }
 };
 
 }
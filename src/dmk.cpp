@@ -2,46 +2,187 @@
 #include "../bits.hpp"
 #include "../random.hpp"
 #include "../sorting.hpp"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 namespace dmk{
 // ----- utils.hpp functions implementation -----
 void rawDelete(void* array){
-    ::operator delete(array);
+    std::free(array);
 }
 // ----- bits.hpp functions implementation -----
-unsigned long long twoPower(int x){return 1ull << x;}
-bool isPowerOfTwo(unsigned long long x){return !(x & (x - 1));}
-
-// lg = binary logarithm
-int lgFloor(unsigned long long x){
-    assert(x);
-    int result = 0;
-    while(x >>= 1) ++result;
+// bulk bit kernels, picked once per process from what the cpu supports,
+// for every 64 bit word type
+namespace{
+template<typename OP, typename WORD> void combineWordsScalar(WORD* to, WORD const* from, long long n)
+    {bits::combineWords<OP>(to, from, n);}
+template<typename OP, typename WORD> long long popCountScalar(WORD const* a, WORD const* b, long long n)
+    {return bits::popCountCombined<OP>(a, b, n);}
+
+struct FirstOp{template<typename WORD> static WORD apply(WORD a, WORD){return a;}};
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define DMK_X86_DISPATCH
+
+template<typename OP, typename WORD> __attribute__((target("popcnt")))
+long long popCountPopcnt(WORD const* a, WORD const* b, long long n){
+    long long result = 0;
+    for(long long i = 0; i < n; ++i)
+        result += __builtin_popcountll(OP::apply(a[i], b[i]));
     return result;
 }
-int lgCeiling(unsigned long long x){return lgFloor(x) + !isPowerOfTwo(x);}
-unsigned long long nextPowerOfTwo(unsigned long long x){
-    return isPowerOfTwo(x) ? x : twoPower(lgFloor(x) + 1);}
-
-bool bits::get(unsigned long long x, int i){ return x & twoPower(i);}
-bool bits::flip(unsigned long long x, int i){ return x ^ twoPower(i);}
-unsigned long long bits::upperMask(int n){return FULL<< n;}
-unsigned long long bits::lowerMask(int n){return ~upperMask(n);}
-unsigned long long bits::middleMask(int i, int n){return lowerMask(n)<<i;}
-unsigned long long bits::getValue(unsigned long long x, int i, int n){
-    return (x >>i) & lowerMask(n);
+
+// vector forms of the word operations
+struct AndOp256{__attribute__((target("avx2"))) static __m256i apply(__m256i a, __m256i b)
+    {return _mm256_and_si256(a, b);}};
+struct OrOp256{__attribute__((target("avx2"))) static __m256i apply(__m256i a, __m256i b)
+    {return _mm256_or_si256(a, b);}};
+struct XorOp256{__attribute__((target("avx2"))) static __m256i apply(__m256i a, __m256i b)
+    {return _mm256_xor_si256(a, b);}};
+struct AndNotOp256{__attribute__((target("avx2"))) static __m256i apply(__m256i a, __m256i b)
+    {return _mm256_andnot_si256(b, a);}};
+struct FirstOp256{__attribute__((target("avx2"))) static __m256i apply(__m256i a, __m256i)
+    {return a;}};
+
+template<typename OP, typename OP256, typename WORD> __attribute__((target("avx2")))
+void combineWordsAVX2(WORD* to, WORD const* from, long long n){
+    long long i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256i x = _mm256_loadu_si256((__m256i const*)(to + i)),
+            y = _mm256_loadu_si256((__m256i const*)(from + i));
+        _mm256_storeu_si256((__m256i*)(to + i), OP256::apply(x, y));
+    }
+    for(; i < n; ++i) to[i] = OP::apply(to[i], from[i]);
+}
+
+// per 64 bit lane counts by nibble table lookup
+__attribute__((target("avx2"))) inline __m256i popCount256(__m256i v){
+    __m256i const table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4),
+        low = _mm256_set1_epi8(0x0f);
+    __m256i counts = _mm256_add_epi8(
+        _mm256_shuffle_epi8(table, _mm256_and_si256(v, low)),
+        _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+    return _mm256_sad_epu8(counts, _mm256_setzero_si256());
 }
 
-int popCountWord(unsigned long long x){
-    static PopCount8 p8;
-    int result = 0;
-    for(; x; x >>= 8) result += p8(x);
+// carry save adder, h:l = a + b + c bitwise
+__attribute__((target("avx2"))) inline void csa(__m256i& h, __m256i& l, __m256i a, __m256i b, __m256i c){
+    __m256i u = _mm256_xor_si256(a, b);
+    h = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+    l = _mm256_xor_si256(u, c);
+}
+
+// Harley-Seal: 16 vectors are reduced by a tree of carry save adders so
+// that only one in 16 needs a full population count
+template<typename OP, typename OP256, typename WORD> __attribute__((target("avx2")))
+long long popCountAVX2(WORD const* a, WORD const* b, long long n){
+    __m256i total = _mm256_setzero_si256(), ones = total, twos = total,
+        fours = total, eights = total, sixteens, twosA, twosB, foursA, foursB,
+        eightsA, eightsB;
+    long long i = 0;
+    auto load = [a, b](long long j) __attribute__((target("avx2"))) {
+        return OP256::apply(_mm256_loadu_si256((__m256i const*)(a + j)),
+                            _mm256_loadu_si256((__m256i const*)(b + j)));};
+    for(; i + 64 <= n; i += 64){
+        csa(twosA, ones, ones, load(i), load(i + 4));
+        csa(twosB, ones, ones, load(i + 8), load(i + 12));
+        csa(foursA, twos, twos, twosA, twosB);
+        csa(twosA, ones, ones, load(i + 16), load(i + 20));
+        csa(twosB, ones, ones, load(i + 24), load(i + 28));
+        csa(foursB, twos, twos, twosA, twosB);
+        csa(eightsA, fours, fours, foursA, foursB);
+        csa(twosA, ones, ones, load(i + 32), load(i + 36));
+        csa(twosB, ones, ones, load(i + 40), load(i + 44));
+        csa(foursA, twos, twos, twosA, twosB);
+        csa(twosA, ones, ones, load(i + 48), load(i + 52));
+        csa(twosB, ones, ones, load(i + 56), load(i + 60));
+        csa(foursB, twos, twos, twosA, twosB);
+        csa(eightsB, fours, fours, foursA, foursB);
+        csa(sixteens, eights, eights, eightsA, eightsB);
+        total = _mm256_add_epi64(total, popCount256(sixteens));
+    }
+    total = _mm256_slli_epi64(total, 4);
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(popCount256(eights), 3));
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(popCount256(fours), 2));
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(popCount256(twos), 1));
+    total = _mm256_add_epi64(total, popCount256(ones));
+    for(; i + 4 <= n; i += 4) total = _mm256_add_epi64(total, popCount256(load(i)));
+    long long result = _mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1) +
+        _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3);
+    for(; i < n; ++i) result += __builtin_popcountll(OP::apply(a[i], b[i]));
     return result;
 }
+#endif
+
+template<typename WORD> struct BitKernels{
+    static_assert(sizeof(WORD) == 8, "the vector kernels count 64 bit lanes");
+    typedef void (*Combine)(WORD*, WORD const*, long long);
+    typedef long long (*Count)(WORD const*, WORD const*, long long);
+    Combine andWords, orWords, xorWords, andNotWords;
+    Count popCount, popCountAnd, popCountOr, popCountXor, popCountAndNot;
+    BitKernels():
+        andWords(combineWordsScalar<bits::AndOp, WORD>),
+        orWords(combineWordsScalar<bits::OrOp, WORD>),
+        xorWords(combineWordsScalar<bits::XorOp, WORD>),
+        andNotWords(combineWordsScalar<bits::AndNotOp, WORD>),
+        popCount(popCountScalar<FirstOp, WORD>),
+        popCountAnd(popCountScalar<bits::AndOp, WORD>),
+        popCountOr(popCountScalar<bits::OrOp, WORD>),
+        popCountXor(popCountScalar<bits::XorOp, WORD>),
+        popCountAndNot(popCountScalar<bits::AndNotOp, WORD>){
+#ifdef DMK_X86_DISPATCH
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("popcnt")){
+            popCount = popCountPopcnt<FirstOp, WORD>;
+            popCountAnd = popCountPopcnt<bits::AndOp, WORD>;
+            popCountOr = popCountPopcnt<bits::OrOp, WORD>;
+            popCountXor = popCountPopcnt<bits::XorOp, WORD>;
+            popCountAndNot = popCountPopcnt<bits::AndNotOp, WORD>;
+        }
+        if(__builtin_cpu_supports("avx2")){
+            andWords = combineWordsAVX2<bits::AndOp, AndOp256, WORD>;
+            orWords = combineWordsAVX2<bits::OrOp, OrOp256, WORD>;
+            xorWords = combineWordsAVX2<bits::XorOp, XorOp256, WORD>;
+            andNotWords = combineWordsAVX2<bits::AndNotOp, AndNotOp256, WORD>;
+            popCount = popCountAVX2<FirstOp, FirstOp256, WORD>;
+            popCountAnd = popCountAVX2<bits::AndOp, AndOp256, WORD>;
+            popCountOr = popCountAVX2<bits::OrOp, OrOp256, WORD>;
+            popCountXor = popCountAVX2<bits::XorOp, XorOp256, WORD>;
+            popCountAndNot = popCountAVX2<bits::AndNotOp, AndNotOp256, WORD>;
+        }
+#endif
+    }
+};
 
-int rightmost0Count(unsigned long long x){
-    return popCountWord(~x & (x - 1));
+template<typename WORD> BitKernels<WORD> const& bitKernels(){
+    static BitKernels<WORD> kernels;
+    return kernels;
 }
+}
+
+void bits::andWords(unsigned long long* to, unsigned long long const* from, long long n){bitKernels<unsigned long long>().andWords(to, from, n);}
+void bits::orWords(unsigned long long* to, unsigned long long const* from, long long n){bitKernels<unsigned long long>().orWords(to, from, n);}
+void bits::xorWords(unsigned long long* to, unsigned long long const* from, long long n){bitKernels<unsigned long long>().xorWords(to, from, n);}
+void bits::andNotWords(unsigned long long* to, unsigned long long const* from, long long n){bitKernels<unsigned long long>().andNotWords(to, from, n);}
+long long bits::popCountWords(unsigned long long const* words, long long n){return bitKernels<unsigned long long>().popCount(words, words, n);}
+long long bits::popCountAnd(unsigned long long const* a, unsigned long long const* b, long long n){return bitKernels<unsigned long long>().popCountAnd(a, b, n);}
+long long bits::popCountOr(unsigned long long const* a, unsigned long long const* b, long long n){return bitKernels<unsigned long long>().popCountOr(a, b, n);}
+long long bits::popCountXor(unsigned long long const* a, unsigned long long const* b, long long n){return bitKernels<unsigned long long>().popCountXor(a, b, n);}
+long long bits::popCountAndNot(unsigned long long const* a, unsigned long long const* b, long long n){return bitKernels<unsigned long long>().popCountAndNot(a, b, n);}
+
+#if ULONG_MAX == 0xffffffffffffffffull
+void bits::andWords(unsigned long* to, unsigned long const* from, long long n){bitKernels<unsigned long>().andWords(to, from, n);}
+void bits::orWords(unsigned long* to, unsigned long const* from, long long n){bitKernels<unsigned long>().orWords(to, from, n);}
+void bits::xorWords(unsigned long* to, unsigned long const* from, long long n){bitKernels<unsigned long>().xorWords(to, from, n);}
+void bits::andNotWords(unsigned long* to, unsigned long const* from, long long n){bitKernels<unsigned long>().andNotWords(to, from, n);}
+long long bits::popCountWords(unsigned long const* words, long long n){return bitKernels<unsigned long>().popCount(words, words, n);}
+long long bits::popCountAnd(unsigned long const* a, unsigned long const* b, long long n){return bitKernels<unsigned long>().popCountAnd(a, b, n);}
+long long bits::popCountOr(unsigned long const* a, unsigned long const* b, long long n){return bitKernels<unsigned long>().popCountOr(a, b, n);}
+long long bits::popCountXor(unsigned long const* a, unsigned long const* b, long long n){return bitKernels<unsigned long>().popCountXor(a, b, n);}
+long long bits::popCountAndNot(unsigned long const* a, unsigned long const* b, long long n){return bitKernels<unsigned long>().popCountAndNot(a, b, n);}
+#endif
 
 // ----- utils.hpp functions implementation -----
 uint32_t xorshiftTransform(uint32_t x){
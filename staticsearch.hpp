@@ -0,0 +1,200 @@
+#ifndef STATICSEARCH_H
+#define STATICSEARCH_H
+
+#include <type_traits>
+#include "utils.hpp"
+#include "vector.hpp"
+#include "bits.hpp"
+#include "sorting.hpp"
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace dmk{
+
+    // Read-only search index over a sorted array in Eytzinger (BFS heap)
+    // order, node k has children 2k and 2k + 1. The descent is branchless
+    // and prefetches the line holding the descendants a few levels down,
+    // so the misses of those levels overlap. Results are
+    // positions in the sorted array, as with binarySearch.
+    template<typename KEY, typename COMPARATOR = DefaultComparator<KEY> >
+    class EytzingerSearch{
+        enum{STRIDE = sizeof(KEY) >= 32 ? 2 : 64 / nextPowerOfTwo(sizeof(KEY)),
+            GROUP = 16};
+        COMPARATOR c;
+        int n;
+        Vector<KEY> keys; // 1-based, keys[0] is unused
+        Vector<int> ranks; // position of keys[k] in the sorted array
+
+        int build(KEY const* sorted, int i, int k){
+            if(k <= n){
+                i = build(sorted, i, 2 * k);
+                keys[k] = sorted[i];
+                ranks[k] = i++;
+                i = build(sorted, i, 2 * k + 1);
+            }
+            return i;
+        }
+        // the node of the result or 0 if all keys are less, from the path
+        // of the descent where the last right turns are undone
+        static int lastLeftTurn(unsigned k){return k >> (rightmost0Count(~k) + 1);}
+        void prefetch(int k)const{__builtin_prefetch(keys.getArray() + (long long)k * STRIDE);}
+        int descend(KEY const& key)const{
+            int k = 1;
+            while(k <= n){
+                prefetch(k);
+                k = 2 * k + c(keys[k], key);
+            }
+            return lastLeftTurn(k);
+        }
+    public:
+        EytzingerSearch(KEY const* sorted, int theN, COMPARATOR const& theC = COMPARATOR()):
+            c(theC), n(theN), keys(theN + 1, KEY()), ranks(theN + 1, theN){
+            assert(n == 0 || isSorted(sorted, 0, n - 1, c));
+            build(sorted, 0, 1);
+        }
+
+        int getSize()const{return n;}
+
+        // position of the first key not less than key, n if none
+        int lowerBound(KEY const& key)const{return ranks[descend(key)];}
+        // position of a key equal to key, -1 if none
+        int find(KEY const& key)const{
+            int k = descend(key);
+            return k && c.isEqual(keys[k], key) ? ranks[k] : -1;
+        }
+
+        // lowerBound of every query, descending GROUP of them level by
+        // level so that their cache misses overlap
+        void lowerBounds(KEY const* queries, int count, int* results)const{
+            int levels = n > 0 ? lgFloor(n) : 0, k[GROUP];
+            for(int first = 0; first < count; first += GROUP){
+                int size = std::min<int>(GROUP, count - first);
+                KEY const* q = queries + first;
+                for(int j = 0; j < size; ++j) k[j] = 1;
+                // all paths are at least this long
+                for(int level = 0; level < levels; ++level)
+                    for(int j = 0; j < size; ++j){
+                        prefetch(k[j]);
+                        k[j] = 2 * k[j] + c(keys[k[j]], q[j]);
+                    }
+                for(int j = 0; j < size; ++j){
+                    if(k[j] <= n) k[j] = 2 * k[j] + c(keys[k[j]], q[j]);
+                    results[first + j] = ranks[lastLeftTurn(k[j])];
+                }
+            }
+        }
+    };
+
+    // Read-only static B+ tree over a sorted array. Leaves are the sorted
+    // keys in nodes of B, padded with the largest key, and every internal
+    // node holds the largest keys of its first B of B + 1 children. Nodes
+    // are a cache line of ints and are searched by counting the keys less
+    // than the query, with SIMD compares for ints and the default order.
+    // All paths have the same length, which makes batches easy to overlap.
+    template<typename KEY, typename COMPARATOR = DefaultComparator<KEY> >
+    class StaticBTree{
+        enum{B = 16, GROUP = 16};
+        COMPARATOR c;
+        int n;
+        Vector<KEY> nodes; // layer by layer from the leaves
+        Vector<int> offsets, sizes; // first node and node count per layer
+
+        static int countLess(KEY const* node, KEY const& key, COMPARATOR const& c){
+#if defined(__AVX2__) || defined(__SSE2__)
+            if constexpr(std::is_same<KEY, int>::value &&
+                std::is_same<COMPARATOR, DefaultComparator<int> >::value){
+#ifdef __AVX2__
+                __m256i x = _mm256_set1_epi32(key);
+                unsigned mask = 0;
+                for(int i = 0; i < B; i += 8) mask |= unsigned(_mm256_movemask_ps(
+                    _mm256_castsi256_ps(_mm256_cmpgt_epi32(x,
+                    _mm256_loadu_si256((__m256i const*)(node + i)))))) << i;
+#else
+                __m128i x = _mm_set1_epi32(key);
+                unsigned mask = 0;
+                for(int i = 0; i < B; i += 4) mask |= unsigned(_mm_movemask_ps(
+                    _mm_castsi128_ps(_mm_cmpgt_epi32(x,
+                    _mm_loadu_si128((__m128i const*)(node + i)))))) << i;
+#endif
+                return popCountWord(mask);
+            }
+#endif
+            int result = 0;
+            for(int i = 0; i < B; ++i) result += c(node[i], key);
+            return result;
+        }
+        KEY const* node(int layer, int i)const
+            {return nodes.getArray() + (long long)(offsets[layer] + i) * B;}
+        // one step down from node i of layer
+        int child(int layer, int i, KEY const& key)const{
+            return std::min(i * (B + 1) + countLess(node(layer, i), key, c),
+                sizes[layer - 1] - 1);
+        }
+        int leafRank(int i, KEY const& key)const
+            {return std::min(i * B + countLess(node(0, i), key, c), n);}
+    public:
+        StaticBTree(KEY const* sorted, int theN, COMPARATOR const& theC = COMPARATOR()):
+            c(theC), n(theN){
+            assert(n == 0 || isSorted(sorted, 0, n - 1, c));
+            if(n == 0) return;
+            for(int size = (n + B - 1) / B;; size = (size + B) / (B + 1)){
+                offsets.append(offsets.getSize() ? offsets.lastItem() + sizes.lastItem() : 0);
+                sizes.append(size);
+                if(size == 1) break;
+            }
+            KEY largest = sorted[n - 1];
+            nodes = Vector<KEY>((offsets.lastItem() + 1) * B, largest);
+            for(int i = 0; i < n; ++i) nodes[i] = sorted[i];
+            for(int layer = 1; layer < sizes.getSize(); ++layer){
+                // the largest key under a child is the last of its last leaf
+                long long leaves = 1;
+                for(int i = 1; i < layer; ++i) leaves *= B + 1;
+                KEY* first = nodes.getArray() + (long long)offsets[layer] * B;
+                for(int i = 0; i < sizes[layer]; ++i)
+                    for(int j = 0; j < B; ++j){
+                        long long leaf = ((long long)i * (B + 1) + j + 1) * leaves * B - 1;
+                        first[(long long)i * B + j] = leaf < n ? nodes[leaf] : largest;
+                    }
+            }
+        }
+
+        int getSize()const{return n;}
+
+        // position of the first key not less than key, n if none
+        int lowerBound(KEY const& key)const{
+            if(n == 0) return 0;
+            int i = 0;
+            for(int layer = sizes.getSize() - 1; layer > 0; --layer) i = child(layer, i, key);
+            return leafRank(i, key);
+        }
+        // position of a key equal to key, -1 if none
+        int find(KEY const& key)const{
+            int i = lowerBound(key);
+            return i < n && c.isEqual(nodes[i], key) ? i : -1;
+        }
+
+        // lowerBound of every query, descending GROUP of them layer by
+        // layer so that their cache misses overlap
+        void lowerBounds(KEY const* queries, int count, int* results)const{
+            int i[GROUP];
+            for(int first = 0; first < count; first += GROUP){
+                int size = std::min<int>(GROUP, count - first);
+                KEY const* q = queries + first;
+                if(n == 0){
+                    for(int j = 0; j < size; ++j) results[first + j] = 0;
+                    continue;
+                }
+                for(int j = 0; j < size; ++j) i[j] = 0;
+                for(int layer = sizes.getSize() - 1; layer > 0; --layer)
+                    for(int j = 0; j < size; ++j) i[j] = child(layer, i[j], q[j]);
+                for(int j = 0; j < size; ++j) results[first + j] = leafRank(i[j], q[j]);
+            }
+        }
+    };
+
+}
+
+#endif // STATICSEARCH_H
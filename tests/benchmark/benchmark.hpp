@@ -0,0 +1,82 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <string>
+#include "../../vector.hpp"
+
+namespace dmk{
+
+    // keeps the compiler from optimizing away a computed value
+    template<typename T> void doNotOptimize(T const& value){
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    // Inputs are generated from fixed seeds, so runs of different
+    // revisions time the same work and their JSON output can be diffed.
+    class BenchmarkReporter{
+        struct Result{
+            std::string name;
+            long long n;
+            double seconds;
+        };
+        int repetitions;
+        std::string filter;
+        Vector<Result> results;
+
+        static std::string quoted(std::string const& s){
+            std::string result = "\"";
+            for(char c : s){
+                if(c == '"' || c == '\\') result += '\\';
+                result += c;
+            }
+            return result + "\"";
+        }
+    public:
+        BenchmarkReporter(int theRepetitions = 5, std::string const& theFilter = ""):
+            repetitions(theRepetitions), filter(theFilter) {}
+
+        // times the best of several runs of f, which processes n items,
+        // unless the name doesn't contain the filter
+        template<typename FUNCTION>
+        void run(std::string const& name, long long n, FUNCTION f){
+            if(name.find(filter) == std::string::npos) return;
+            double best = std::numeric_limits<double>::max();
+            for(int i = 0; i < repetitions; ++i){
+                auto start = std::chrono::steady_clock::now();
+                f();
+                std::chrono::duration<double> elapsed =
+                    std::chrono::steady_clock::now() - start;
+                best = std::min(best, elapsed.count());
+            }
+            report(name, n, best);
+        }
+
+        void report(std::string const& name, long long n, double seconds){
+            results.append(Result{name, n, seconds});
+            std::cout << std::left << std::setw(48) << name << std::right
+                << std::setw(12) << std::fixed << std::setprecision(3)
+                << seconds * 1000 << " ms" << std::setw(16)
+                << seconds * 1e9 / n << " ns/item" << std::endl;
+        }
+
+        void writeJson(std::ostream& out)const{
+            out << "{\n  \"compiler\": " << quoted(__VERSION__) <<
+                ",\n  \"repetitions\": " << repetitions << ",\n  \"results\": [";
+            for(int i = 0; i < results.getSize(); ++i){
+                Result const& r = results[i];
+                out << (i ? ",\n" : "\n") << "    {\"name\": " << quoted(r.name) <<
+                    ", \"items\": " << r.n << std::setprecision(9) <<
+                    ", \"seconds\": " << r.seconds << std::setprecision(3) <<
+                    ", \"nsPerItem\": " << r.seconds * 1e9 / r.n << "}";
+            }
+            out << "\n  ]\n}\n";
+        }
+    };
+
+}
+
+#endif // BENCHMARK_H
@@ -0,0 +1,99 @@
+#include "benchmark.hpp"
+#include "../../bits.hpp"
+#include "../../random.hpp"
+
+using namespace dmk;
+
+namespace{
+    enum{BITS = 1 << 24, QUERIES = 1 << 20, WIDTH = 13};
+
+    // the previous out of line, table based versions, for comparison
+    __attribute__((noinline)) int tablePopCountWord(unsigned long long x){
+        static PopCount8 p8;
+        int result = 0;
+        for(; x; x >>= 8) result += p8(x);
+        return result;
+    }
+    __attribute__((noinline)) unsigned long long outOfLineMask(int n)
+        {return ~(n < 64 ? bits::FULL << n : bits::ZERO);}
+    unsigned long long tableGetValue(Bitset<> const& b, int i, int n){
+        Vector<unsigned long long> const& words = b.getStorage();
+        unsigned long long result = 0;
+        for(int word = i / 64, bit = i % 64, shift = 0; n > 0; bit = 0){
+            int m = std::min(n, 64 - bit);
+            result |= ((words[word++] >> bit) & outOfLineMask(m)) << shift;
+            shift += m;
+            n -= m;
+        }
+        return result;
+    }
+    __attribute__((noinline)) unsigned long long tableReverseBits(unsigned long long x){
+        static ReverseBits8 r8;
+        unsigned long long result = 0;
+        for(int i = 0; i < 8; ++i, x >>= 8) result = (result << 8) + r8(x);
+        return result;
+    }
+}
+
+void benchmarkBits(BenchmarkReporter& r){
+    Random<> random(1);
+    Bitset<> b(BITS);
+    for(int i = 0; i < BITS; ++i) if(random.mod(2)) b.set(i);
+    Vector<unsigned long long> const& words = b.getStorage();
+    long long wordCount = words.getSize();
+
+    r.run("popCount table, out of line", BITS, [&]{
+        long long result = 0;
+        for(long long i = 0; i < wordCount; ++i) result += tablePopCountWord(words[i]);
+        doNotOptimize(result);
+    });
+    r.run("popCount inline word loop", BITS, [&]{
+        doNotOptimize(bits::popCountWords<unsigned long long>(words.getArray(), wordCount));
+    });
+    r.run("Bitset::popCount", BITS, [&]{doNotOptimize(b.popCount());});
+
+    r.run("getValue out of line masks, 13 bit fields", QUERIES, [&]{
+        unsigned long long result = 0;
+        for(int i = 0; i < QUERIES; ++i) result ^= tableGetValue(b, i * WIDTH, WIDTH);
+        doNotOptimize(result);
+    });
+    r.run("Bitset::getValue, 13 bit fields", QUERIES, [&]{
+        unsigned long long result = 0;
+        for(int i = 0; i < QUERIES; ++i) result ^= b.getValue(i * WIDTH, WIDTH);
+        doNotOptimize(result);
+    });
+
+    Vector<unsigned long long> scratch = words;
+    r.run("reverseBits table", BITS, [&]{
+        for(long long i = 0; i < wordCount; ++i) scratch[i] = tableReverseBits(scratch[i]);
+        doNotOptimize(scratch.getArray());
+    });
+    r.run("reverseBits word swaps", BITS, [&]{
+        for(long long i = 0; i < wordCount; ++i) scratch[i] = reverseBits(scratch[i]);
+        doNotOptimize(scratch.getArray());
+    });
+    Bitset<> odd(BITS - 3);
+    r.run("Bitset::reverse", BITS, [&]{
+        odd.reverse();
+        doNotOptimize(odd.getStorage().getArray());
+    });
+
+    Bitset<> other(BITS), result(BITS);
+    for(int i = 0; i < BITS; ++i) if(random.mod(4) == 0) other.set(i);
+    r.run("Bitset &=", BITS, [&]{
+        result = b;
+        doNotOptimize((result &= other).getStorage().getArray());
+    });
+    r.run("Bitset |=", BITS, [&]{
+        result = b;
+        doNotOptimize((result |= other).getStorage().getArray());
+    });
+    Vector<int> positions;
+    for(int i = 0; i < QUERIES; ++i) positions.append(random.mod(BITS));
+    r.run("Bitset set/get, random positions", 2 * QUERIES, [&]{
+        int count = 0;
+        for(int i = 0; i < QUERIES; ++i) result.set(positions[i], i % 2);
+        for(int i = 0; i < QUERIES; ++i) count += result[positions[i]];
+        doNotOptimize(count);
+    });
+}
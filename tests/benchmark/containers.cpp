@@ -0,0 +1,98 @@
+#include "benchmark.hpp"
+#include "../../vector.hpp"
+#include "../../queue.hpp"
+#include "../../stack.hpp"
+#include "../../freelist.hpp"
+#include "../../unionfind.hpp"
+#include "../../random.hpp"
+
+using namespace dmk;
+
+namespace{
+    enum{ITEMS = 1 << 22, NODES = 1 << 20, WINDOW = 1000};
+
+    struct Node{
+        Node* next;
+        long long key;
+        double value[2];
+    };
+
+    // allocates all nodes, then frees them in random order
+    template<typename ALLOCATE, typename REMOVE>
+    void allocateRemove(Vector<int> const& order, ALLOCATE allocate, REMOVE remove){
+        Vector<Node*> nodes(NODES);
+        for(int i = 0; i < NODES; ++i) nodes[i] = allocate();
+        for(int i = 0; i < NODES; ++i) remove(nodes[order[i]]);
+    }
+}
+
+void benchmarkContainers(BenchmarkReporter& r){
+    Random<> random(10);
+    r.run("Vector append", ITEMS, []{
+        Vector<int> v;
+        for(int i = 0; i < ITEMS; ++i) v.append(i);
+        doNotOptimize(v.getArray());
+    });
+    r.run("Vector append after reserve", ITEMS, []{
+        Vector<int> v;
+        v.reserve(ITEMS);
+        for(int i = 0; i < ITEMS; ++i) v.append(i);
+        doNotOptimize(v.getArray());
+    });
+    r.run("Vector append/removeLast", 2 * ITEMS, []{
+        // grows and shrinks through every capacity
+        Vector<int> v;
+        for(int i = 0; i < ITEMS; ++i) v.append(i);
+        while(v.getSize() > 0) v.removeLast();
+        doNotOptimize(v.getArray());
+    });
+
+    r.run("Queue push/pop, steady", 2 * ITEMS, []{
+        Queue<int> q;
+        for(int i = 0; i < WINDOW; ++i) q.push(i);
+        for(int i = 0; i < ITEMS; ++i){
+            q.push(i);
+            doNotOptimize(q.pop());
+        }
+    });
+    r.run("Queue push all/pop all", 2 * ITEMS, []{
+        Queue<int> q;
+        for(int i = 0; i < ITEMS; ++i) q.push(i);
+        while(!q.isEmpty()) doNotOptimize(q.pop());
+    });
+    r.run("Stack push all/pop all", 2 * ITEMS, []{
+        Stack<int> s;
+        for(int i = 0; i < ITEMS; ++i) s.push(i);
+        while(!s.isEmpty()) doNotOptimize(s.pop());
+    });
+
+    Vector<int> order(NODES);
+    for(int i = 0; i < NODES; ++i) order[i] = i;
+    for(int i = NODES - 1; i > 0; --i) std::swap(order[i], order[random.mod(i + 1)]);
+    r.run("new/delete nodes", 2 * NODES, [&]{
+        allocateRemove(order, []{return new Node;}, [](Node* node){delete node;});
+    });
+    r.run("Freelist allocate/remove nodes", 2 * NODES, [&]{
+        Freelist<Node> f;
+        allocateRemove(order, [&f]{return new(f.allocate())Node;},
+            [&f](Node* node){f.remove(node);});
+    });
+
+    Vector<int> left(NODES), right(NODES);
+    for(int i = 0; i < NODES; ++i){
+        left[i] = random.mod(NODES);
+        right[i] = random.mod(NODES);
+    }
+    r.run("UnionFind join", NODES, [&]{
+        UnionFind u(NODES);
+        for(int i = 0; i < NODES; ++i) u.join(left[i], right[i]);
+        doNotOptimize(u.find(0));
+    });
+    UnionFind joined(NODES);
+    for(int i = 0; i < NODES / 2; ++i) joined.join(left[i], right[i]);
+    r.run("UnionFind find", NODES, [&]{
+        int result = 0;
+        for(int i = 0; i < NODES; ++i) result += joined.find(left[i]);
+        doNotOptimize(result);
+    });
+}
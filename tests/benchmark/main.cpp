@@ -0,0 +1,50 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include "benchmark.hpp"
+
+void benchmarkBits(dmk::BenchmarkReporter& r);
+void benchmarkContainers(dmk::BenchmarkReporter& r);
+void benchmarkRandom(dmk::BenchmarkReporter& r);
+void benchmarkSmallVector(dmk::BenchmarkReporter& r);
+void benchmarkRankSelect(dmk::BenchmarkReporter& r);
+void benchmarkPackedVector(dmk::BenchmarkReporter& r);
+void benchmarkSorting(dmk::BenchmarkReporter& r);
+void benchmarkSearch(dmk::BenchmarkReporter& r);
+void benchmarkSparse(dmk::BenchmarkReporter& r);
+
+// 020-Benchmark [--filter text] [--repetitions n] [--json file]
+int main(int argc, char *argv[]) {
+    std::string filter, json;
+    int repetitions = 5;
+    for(int i = 1; i < argc; i += 2){
+        bool known = !std::strcmp(argv[i], "--filter") ||
+            !std::strcmp(argv[i], "--repetitions") || !std::strcmp(argv[i], "--json");
+        if(!known){
+            std::cerr << "unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+        if(i + 1 == argc){
+            std::cerr << "missing value for " << argv[i] << std::endl;
+            return 1;
+        }
+        if(!std::strcmp(argv[i], "--filter")) filter = argv[i + 1];
+        else if(!std::strcmp(argv[i], "--repetitions")) repetitions = std::atoi(argv[i + 1]);
+        else json = argv[i + 1];
+    }
+    dmk::BenchmarkReporter r(std::max(1, repetitions), filter);
+    benchmarkContainers(r);
+    benchmarkRandom(r);
+    benchmarkBits(r);
+    benchmarkSmallVector(r);
+    benchmarkRankSelect(r);
+    benchmarkPackedVector(r);
+    benchmarkSorting(r);
+    benchmarkSearch(r);
+    benchmarkSparse(r);
+    if(!json.empty()){
+        std::ofstream out(json);
+        r.writeJson(out);
+    }
+    return 0;
+}
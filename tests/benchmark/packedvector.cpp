@@ -0,0 +1,47 @@
+#include "benchmark.hpp"
+#include "../../packedvector.hpp"
+#include "../../bits.hpp"
+#include "../../random.hpp"
+
+using namespace dmk;
+
+namespace{
+    enum{ITEMS = 1 << 22};
+
+    template<int BITS> void benchmarkWidth(BenchmarkReporter& r){
+        Random<> random(BITS);
+        PackedVector<BITS> p;
+        Bitset<unsigned long long> b;
+        for(int i = 0; i < ITEMS; ++i){
+            unsigned long long value = random.next() & bits::lowerMask(BITS);
+            p.append(value);
+            b.appendValue(value, BITS);
+        }
+        Vector<unsigned int> out(ITEMS);
+        std::string width = std::to_string(BITS) + " bit ";
+        r.run(width + "Bitset::getValue loop", ITEMS, [&]{
+            for(int i = 0; i < ITEMS; ++i) out[i] = b.getValue(i * BITS, BITS);
+            doNotOptimize(out.getArray());
+        });
+        r.run(width + "PackedVector get loop", ITEMS, [&]{
+            for(int i = 0; i < ITEMS; ++i) out[i] = p[i];
+            doNotOptimize(out.getArray());
+        });
+        r.run(width + "PackedVector decode", ITEMS, [&]{
+            p.decode(0, ITEMS, out.getArray());
+            doNotOptimize(out.getArray());
+        });
+        r.run(width + "PackedVector encode", ITEMS, [&]{
+            p.encode(0, ITEMS, out.getArray());
+            doNotOptimize(p.getStorage().getArray());
+        });
+    }
+}
+
+void benchmarkPackedVector(BenchmarkReporter& r){
+    benchmarkWidth<3>(r);
+    benchmarkWidth<7>(r);
+    benchmarkWidth<12>(r);
+    benchmarkWidth<17>(r);
+    benchmarkWidth<32>(r);
+}
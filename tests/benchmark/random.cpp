@@ -0,0 +1,36 @@
+#include "benchmark.hpp"
+#include "../../random.hpp"
+
+using namespace dmk;
+
+namespace{
+    enum{NUMBERS = 1 << 24, SEED = 20};
+
+    template<typename GENERATOR> void generate(GENERATOR& g){
+        unsigned long long result = 0;
+        for(int i = 0; i < NUMBERS; ++i) result ^= g.next();
+        doNotOptimize(result);
+    }
+}
+
+void benchmarkRandom(BenchmarkReporter& r){
+    QualityXorshift64 xorshift(SEED);
+    MersenneTwister64 mersenne(SEED);
+    MRG32k3a mrg(SEED);
+    ARC4 arc4(SEED);
+    Random<> random(SEED);
+    r.run("QualityXorshift64 next", NUMBERS, [&]{generate(xorshift);});
+    r.run("MersenneTwister64 next", NUMBERS, [&]{generate(mersenne);});
+    r.run("MRG32k3a next", NUMBERS, [&]{generate(mrg);});
+    r.run("ARC4 next", NUMBERS, [&]{generate(arc4);});
+    r.run("Random<> mod", NUMBERS, [&]{
+        unsigned long long result = 0;
+        for(int i = 0; i < NUMBERS; ++i) result += random.mod(1000);
+        doNotOptimize(result);
+    });
+    r.run("Random<> uniform01", NUMBERS, [&]{
+        double result = 0;
+        for(int i = 0; i < NUMBERS; ++i) result += random.uniform01();
+        doNotOptimize(result);
+    });
+}
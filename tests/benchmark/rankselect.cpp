@@ -0,0 +1,62 @@
+#include "benchmark.hpp"
+#include "../../bits.hpp"
+#include "../../rankselect.hpp"
+#include "../../random.hpp"
+
+using namespace dmk;
+
+namespace{
+    enum{BITS = 1 << 26, QUERIES = 1 << 20, SCAN_QUERIES = 1 << 4};
+
+    // the baseline: count words up to the position
+    unsigned long long scanRank(Bitset<> const& b, unsigned long long i){
+        Vector<unsigned long long> const& words = b.getStorage();
+        unsigned long long result = 0;
+        for(unsigned long long w = 0; w < i / 64; ++w) result += popCountWord(words[w]);
+        if(i % 64) result += popCountWord(words[i / 64] & bits::lowerMask(i % 64));
+        return result;
+    }
+
+    unsigned long long scanSelect(Bitset<> const& b, unsigned long long k){
+        Vector<unsigned long long> const& words = b.getStorage();
+        for(int w = 0;; ++w){
+            unsigned long long count = popCountWord(words[w]);
+            if(k < count) return w * 64ull + RankSelect::selectInWord(words[w], k);
+            k -= count;
+        }
+    }
+
+    void benchmarkDensity(BenchmarkReporter& r, unsigned density){
+        Random<> random(density);
+        Bitset<> b(BITS);
+        for(int i = 0; i < BITS; ++i) if(random.mod(100) < density) b.set(i);
+        RankSelect rs(b);
+        Vector<unsigned long long> positions, ranks;
+        for(int i = 0; i < QUERIES; ++i){
+            positions.append(random.mod(BITS));
+            ranks.append(random.mod(rs.getOnes()));
+        }
+        std::string suffix = " " + std::to_string(density) + "%";
+        r.run("RankSelect build" + suffix, BITS, [&]{
+            RankSelect built(b);
+            doNotOptimize(built.getOnes());
+        });
+        r.run("RankSelect rank1" + suffix, QUERIES, [&]{
+            for(int i = 0; i < QUERIES; ++i) doNotOptimize(rs.rank1(positions[i]));
+        });
+        r.run("Linear scan rank1" + suffix, SCAN_QUERIES, [&]{
+            for(int i = 0; i < SCAN_QUERIES; ++i) doNotOptimize(scanRank(b, positions[i]));
+        });
+        r.run("RankSelect select1" + suffix, QUERIES, [&]{
+            for(int i = 0; i < QUERIES; ++i) doNotOptimize(rs.select1(ranks[i]));
+        });
+        r.run("Linear scan select1" + suffix, SCAN_QUERIES, [&]{
+            for(int i = 0; i < SCAN_QUERIES; ++i) doNotOptimize(scanSelect(b, ranks[i]));
+        });
+    }
+}
+
+void benchmarkRankSelect(BenchmarkReporter& r){
+    benchmarkDensity(r, 50);
+    benchmarkDensity(r, 5);
+}
@@ -0,0 +1,49 @@
+#include "benchmark.hpp"
+#include "../../sorting.hpp"
+#include "../../staticsearch.hpp"
+#include "../../random.hpp"
+
+using namespace dmk;
+
+namespace{
+    enum{QUERIES = 1 << 20};
+
+    // in cache and far out of it
+    void benchmarkSize(BenchmarkReporter& r, int n){
+        Random<> random(n);
+        Vector<int> keys(n), queries(QUERIES), results(QUERIES);
+        for(int i = 0; i < n; ++i) keys[i] = 2 * i;
+        for(int i = 0; i < QUERIES; ++i) queries[i] = random.mod(2 * n);
+        EytzingerSearch<int> eytzinger(keys.getArray(), n);
+        StaticBTree<int> tree(keys.getArray(), n);
+        std::string suffix = " " + std::to_string(n);
+        DefaultComparator<int> c;
+        r.run("binarySearch" + suffix, QUERIES, [&]{
+            for(int i = 0; i < QUERIES; ++i)
+                doNotOptimize(binarySearch(keys.getArray(), 0, n - 1, queries[i], c));
+        });
+        r.run("std::lower_bound" + suffix, QUERIES, [&]{
+            for(int i = 0; i < QUERIES; ++i) doNotOptimize(
+                std::lower_bound(keys.getArray(), keys.getArray() + n, queries[i]));
+        });
+        r.run("EytzingerSearch lowerBound" + suffix, QUERIES, [&]{
+            for(int i = 0; i < QUERIES; ++i) doNotOptimize(eytzinger.lowerBound(queries[i]));
+        });
+        r.run("EytzingerSearch lowerBounds" + suffix, QUERIES, [&]{
+            eytzinger.lowerBounds(queries.getArray(), QUERIES, results.getArray());
+            doNotOptimize(results.getArray());
+        });
+        r.run("StaticBTree lowerBound" + suffix, QUERIES, [&]{
+            for(int i = 0; i < QUERIES; ++i) doNotOptimize(tree.lowerBound(queries[i]));
+        });
+        r.run("StaticBTree lowerBounds" + suffix, QUERIES, [&]{
+            tree.lowerBounds(queries.getArray(), QUERIES, results.getArray());
+            doNotOptimize(results.getArray());
+        });
+    }
+}
+
+void benchmarkSearch(BenchmarkReporter& r){
+    benchmarkSize(r, 1 << 12);
+    benchmarkSize(r, 1 << 24);
+}
@@ -0,0 +1,52 @@
+#include "benchmark.hpp"
+#include "../../vector.hpp"
+#include "../../smallvector.hpp"
+#include "../../stack.hpp"
+#include "../../sparse.hpp"
+
+using namespace dmk;
+
+namespace{
+    typedef std::pair<int, double> Item;
+    enum{COLUMNS = 1000000};
+
+    template<typename COLUMN> void constructColumns(){
+        Vector<COLUMN> columns(COLUMNS);
+        doNotOptimize(columns.getArray());
+    }
+
+    template<typename COLUMN> void fillColumns(){
+        // mostly empty columns, with a few holding up to 3 items
+        Vector<COLUMN> columns(COLUMNS);
+        for(int c = 0; c < COLUMNS; ++c)
+            for(int j = 0; j < c % 4; ++j) columns[c].append(Item(j, c));
+        doNotOptimize(columns.getArray());
+    }
+
+    template<typename VECTOR> void stackPushPop(){
+        // many short lived stacks as in depth-first traversals
+        for(int i = 0; i < COLUMNS / 10; ++i){
+            Stack<int, VECTOR> s;
+            for(int j = 0; j < 6; ++j) s.push(j);
+            while(!s.isEmpty()) doNotOptimize(s.pop());
+        }
+    }
+}
+
+void benchmarkSmallVector(BenchmarkReporter& r){
+    r.run("Vector columns construct", COLUMNS,
+          constructColumns<Vector<Item> >);
+    r.run("SmallVector<1> columns construct", COLUMNS,
+          constructColumns<SmallVector<Item, 1> >);
+    r.run("Vector columns fill", COLUMNS, fillColumns<Vector<Item> >);
+    r.run("SmallVector<1> columns fill", COLUMNS,
+          fillColumns<SmallVector<Item, 1> >);
+    r.run("Stack<Vector> push/pop", COLUMNS / 10 * 6,
+          stackPushPop<Vector<int> >);
+    r.run("Stack<SmallVector<8>> push/pop", COLUMNS / 10 * 6,
+          stackPushPop<SmallVector<int, 8> >);
+    r.run("SparseMatrix construct", COLUMNS, []{
+        SparseMatrix<double> m(COLUMNS, COLUMNS);
+        doNotOptimize(m.getColumns());
+    });
+}
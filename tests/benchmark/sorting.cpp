@@ -0,0 +1,244 @@
+#include "benchmark.hpp"
+#include "../../sorting.hpp"
+#include "../../random.hpp"
+
+using namespace dmk;
+
+namespace{
+    enum{ITEMS = 1 << 22};
+
+    // each run sorts a fresh copy of the same input
+    template<typename ITEM, typename SORT>
+    void sortCopy(Vector<ITEM> const& input, Vector<ITEM>& scratch, SORT sort){
+        scratch = input;
+        sort(scratch.getArray(), scratch.getSize());
+        doNotOptimize(scratch.getArray());
+    }
+
+    struct Record{
+        long long key;
+        double value;
+        bool operator<(Record const& rhs)const{return key < rhs.key;}
+    };
+    struct RecordKey{long long operator()(Record const& r)const{return r.key;}};
+
+    void benchmarkPatterns(BenchmarkReporter& r, Random<>& random){
+        Vector<int> sorted(ITEMS), reversed(ITEMS), fewDistinct(ITEMS),
+            organPipe(ITEMS), scratch;
+        for(int i = 0; i < ITEMS; ++i){
+            sorted[i] = i;
+            reversed[i] = ITEMS - i;
+            fewDistinct[i] = random.mod(16);
+            organPipe[i] = i < ITEMS / 2 ? i : ITEMS - i;
+        }
+        std::pair<char const*, Vector<int>*> patterns[] = {{"sorted", &sorted},
+            {"reversed", &reversed}, {"16 distinct", &fewDistinct},
+            {"organ pipe", &organPipe}};
+        DefaultComparator<int> c;
+        for(auto const& pattern : patterns){
+            std::string suffix = std::string(", ") + pattern.first;
+            r.run("quickSort" + suffix, ITEMS, [&]{
+                sortCopy(*pattern.second, scratch, [&](int* v, int n){quickSort(v, 0, n - 1, c);});
+            });
+            r.run("pdqSort" + suffix, ITEMS, [&]{
+                sortCopy(*pattern.second, scratch, [&](int* v, int n){pdqSort(v, 0, n - 1, c);});
+            });
+        }
+    }
+
+    // many tiny arrays one after another, as in per column index lists
+    template<typename ITEM> void benchmarkSmall(BenchmarkReporter& r,
+        std::string const& name, Random<>& random){
+        Vector<ITEM> input(ITEMS), scratch;
+        for(int i = 0; i < ITEMS; ++i) input[i] = ITEM(random.next() % ITEMS);
+        for(int n : {8, 16, 32, 64}){
+            std::string suffix = " " + std::to_string(n) + " " + name;
+            r.run("insertionSort" + suffix, ITEMS, [&]{
+                sortCopy(input, scratch, [n](ITEM* v, int size){
+                    for(int i = 0; i + n <= size; i += n)
+                        insertionSort(v, i, i + n - 1, DefaultComparator<ITEM>());
+                });
+            });
+            r.run("sortSmall" + suffix, ITEMS, [&]{
+                sortCopy(input, scratch, [n](ITEM* v, int size)
+                    {for(int i = 0; i + n <= size; i += n) sortSmall(v + i, n);});
+            });
+        }
+    }
+
+    // stable sorts on inputs with existing order
+    void benchmarkNearlySorted(BenchmarkReporter& r, Random<>& random){
+        Vector<int> swapped(ITEMS), segments(ITEMS), appended(ITEMS), shuffled(ITEMS),
+            scratch, buffer;
+        for(int i = 0; i < ITEMS; ++i){
+            swapped[i] = appended[i] = i;
+            segments[i] = random.mod(ITEMS);
+            shuffled[i] = random.next();
+        }
+        for(int i = 0; i < ITEMS / 100; ++i)
+            std::swap(swapped[random.mod(ITEMS)], swapped[random.mod(ITEMS)]);
+        for(int i = 0; i < ITEMS; i += ITEMS / 16)
+            std::sort(segments.getArray() + i, segments.getArray() + i + ITEMS / 16);
+        for(int i = ITEMS - ITEMS / 100; i < ITEMS; ++i) appended[i] = random.mod(ITEMS);
+        std::pair<char const*, Vector<int>*> inputs[] = {{"1% swapped", &swapped},
+            {"16 sorted segments", &segments}, {"1% appended", &appended},
+            {"random", &shuffled}};
+        DefaultComparator<int> c;
+        for(auto const& input : inputs){
+            std::string suffix = std::string(", ") + input.first;
+            r.run("powerSort" + suffix, ITEMS, [&]{
+                sortCopy(*input.second, scratch, [&](int* v, int n){powerSort(v, n, c, buffer);});
+            });
+            r.run("mergeSort" + suffix, ITEMS, [&]{
+                sortCopy(*input.second, scratch, [&](int* v, int n){mergeSort(v, n, c);});
+            });
+            r.run("std::stable_sort" + suffix, ITEMS, [&]{
+                sortCopy(*input.second, scratch, [](int* v, int n){std::stable_sort(v, v + n);});
+            });
+        }
+    }
+
+    struct WideRecord{
+        long long key;
+        char payload[192];
+        bool operator<(WideRecord const& rhs)const{return key < rhs.key;}
+    };
+
+    // sorting 200 byte records directly, through indices and by argSort
+    void benchmarkWideRecords(BenchmarkReporter& r, Random<>& random){
+        enum{RECORDS = 1 << 18};
+        Vector<WideRecord> input(RECORDS), scratch;
+        for(int i = 0; i < RECORDS; ++i) input[i].key = random.next();
+        r.run("pdqSort 200 byte records", RECORDS, [&]{
+            sortCopy(input, scratch, [](WideRecord* v, int n){pdqSort(v, n);});
+        });
+        r.run("IndexComparator sort 200 byte records", RECORDS, [&]{
+            scratch = input;
+            Vector<int> indices(RECORDS);
+            for(int i = 0; i < RECORDS; ++i) indices[i] = i;
+            IndexComparator<WideRecord> c(IndexTransform<WideRecord>(scratch.getArray()));
+            pdqSort(indices.getArray(), 0, RECORDS - 1, c);
+            applyPermutation(scratch.getArray(), RECORDS, indices.getArray());
+            doNotOptimize(scratch.getArray());
+        });
+        r.run("argSort 200 byte records", RECORDS, [&]{
+            scratch = input;
+            Vector<int> permutation = argSort(scratch.getArray(), RECORDS,
+                [](WideRecord const& record){return record.key;});
+            applyPermutation(scratch.getArray(), RECORDS, permutation.getArray());
+            doNotOptimize(scratch.getArray());
+        });
+    }
+
+    // URLs sharing hosts and path prefixes, every run includes the copy
+    void benchmarkStrings(BenchmarkReporter& r, Random<>& random){
+        enum{STRINGS = 1 << 18};
+        typedef Vector<char> String;
+        char const* hosts[] = {"https://www.example.com/", "https://docs.example.org/",
+            "http://cdn.example.net/static/", "https://example.com/users/"};
+        Vector<String> input, scratch;
+        for(int i = 0; i < STRINGS; ++i){
+            std::string url = hosts[random.mod(4)];
+            for(int depth = random.mod(4) + 1; depth > 0; --depth)
+                url += "section" + std::to_string(random.mod(20)) + "/";
+            url += "page" + std::to_string(random.mod(1000000)) + ".html";
+            String s;
+            for(char ch : url) s.append(ch);
+            input.append(s);
+        }
+        LexicographicComparator<String> c;
+        r.run("pdqSort urls", STRINGS, [&]{
+            sortCopy(input, scratch, [&](String* v, int n){pdqSort(v, 0, n - 1, c);});
+        });
+        r.run("multikeyQuickSort urls", STRINGS, [&]{
+            sortCopy(input, scratch, [](String* v, int n){multikeyQuickSort(v, n);});
+        });
+        r.run("msdRadixSort urls", STRINGS, [&]{
+            sortCopy(input, scratch, [](String* v, int n){msdRadixSort(v, n);});
+        });
+    }
+
+    template<typename ITEM> ITEM randomItem(Random<>& random){return ITEM(random.next());}
+    template<> float randomItem<float>(Random<>& random){return random.uniform01() - 0.5;}
+    template<> Record randomItem<Record>(Random<>& random)
+        {return Record{(long long)random.next(), 0};}
+
+    template<typename ITEM> void benchmarkRadixSort(BenchmarkReporter& r,
+        std::string const& name, Random<>& random){
+        Vector<ITEM> input(ITEMS), scratch;
+        for(int i = 0; i < ITEMS; ++i) input[i] = randomItem<ITEM>(random);
+        r.run("std::sort " + name, ITEMS, [&]{
+            sortCopy(input, scratch, [](ITEM* v, int n){std::sort(v, v + n);});
+        });
+        typedef typename std::conditional<std::is_same<ITEM, Record>::value,
+            RecordKey, IdentityKey<ITEM> >::type Key;
+        RadixSorter<ITEM, Key> sorter;
+        r.run("radixSort " + name, ITEMS, [&]{
+            sortCopy(input, scratch, [&](ITEM* v, int n){sorter.sort(v, n);});
+        });
+    }
+}
+
+void benchmarkSorting(BenchmarkReporter& r){
+    Random<> random(30);
+    Vector<int> input(ITEMS), scratch;
+    for(int i = 0; i < ITEMS; ++i) input[i] = random.next();
+    DefaultComparator<int> c;
+    r.run("quickSort", ITEMS, [&]{
+        sortCopy(input, scratch, [&](int* v, int n){quickSort(v, 0, n - 1, c);});
+    });
+    r.run("mergeSort", ITEMS, [&]{
+        sortCopy(input, scratch, [&](int* v, int n){mergeSort(v, n, c);});
+    });
+    r.run("pdqSort", ITEMS, [&]{
+        sortCopy(input, scratch, [&](int* v, int n){pdqSort(v, 0, n - 1, c);});
+    });
+    benchmarkPatterns(r, random);
+    benchmarkNearlySorted(r, random);
+    r.run("nthElement median", ITEMS, [&]{
+        sortCopy(input, scratch, [&](int* v, int n){nthElement(v, 0, n - 1, n / 2, c);});
+    });
+    r.run("std::nth_element median", ITEMS, [&]{
+        sortCopy(input, scratch, [](int* v, int n){std::nth_element(v, v + n / 2, v + n);});
+    });
+    r.run("partialSort 1000", ITEMS, [&]{
+        sortCopy(input, scratch, [&](int* v, int n){partialSort(v, 0, n - 1, 1000, c);});
+    });
+    r.run("topK 1000", ITEMS, [&]{
+        doNotOptimize(topK(input.getArray(), ITEMS, 1000, c).getArray());
+    });
+    benchmarkWideRecords(r, random);
+    benchmarkStrings(r, random);
+    benchmarkSmall<int>(r, "int", random);
+    benchmarkSmall<double>(r, "double", random);
+    r.run("std::sort", ITEMS, [&]{
+        sortCopy(input, scratch, [](int* v, int n){std::sort(v, v + n);});
+    });
+    RadixSorter<int> intSorter;
+    r.run("radixSort int", ITEMS, [&]{
+        sortCopy(input, scratch, [&](int* v, int n){intSorter.sort(v, n);});
+    });
+    benchmarkRadixSort<unsigned long long>(r, "unsigned long long", random);
+    benchmarkRadixSort<float>(r, "float", random);
+    benchmarkRadixSort<Record>(r, "16 byte record", random);
+
+    // scaling from 1 to all hardware threads
+    int maxThreads = ThreadPool::defaultWorkerCount() + 1;
+    for(int threads = 1;; threads = std::min(2 * threads, maxThreads)){
+        ThreadPool pool(threads - 1);
+        std::string suffix = ", " + std::to_string(threads) + " threads";
+        r.run("parallel quickSort" + suffix, ITEMS, [&]{
+            sortCopy(input, scratch, [&](int* v, int n){quickSort(v, 0, n - 1, c, pool);});
+        });
+        r.run("parallel mergeSort" + suffix, ITEMS, [&]{
+            sortCopy(input, scratch, [&](int* v, int n){mergeSort(v, n, c, pool);});
+        });
+        r.run("parallel topK 1000" + suffix, ITEMS, [&]{
+            doNotOptimize(topK(input.getArray(), ITEMS, 1000, c, pool).getArray());
+        });
+        r.run("parallel radixSort int" + suffix, ITEMS, [&]{
+            sortCopy(input, scratch, [&](int* v, int n){intSorter.sort(v, n, pool);});
+        });
+        if(threads == maxThreads) break;
+    }
+}
@@ -0,0 +1,252 @@
+#include "benchmark.hpp"
+#include "../../sparse.hpp"
+#include "../../compressedsparse.hpp"
+#include "../../krylov.hpp"
+#include "../../random.hpp"
+
+using namespace dmk;
+
+namespace{
+    typedef SparseMatrix<double> Matrix;
+    typedef CompressedSparseMatrix<double> Compressed;
+
+    Matrix randomMatrix(int n, int perColumn, Random<>& random){
+        Matrix result(n, n);
+        for(int c = 0; c < n; ++c)
+            for(int j = 0; j < perColumn; ++j) result.set(random.mod(n), c, random.uniform01());
+        return result;
+    }
+
+    long long countProducts(Matrix const& a, Matrix const& b){
+        long long result = 0;
+        for(int j = 0; j < b.getColumns(); ++j)
+            for(int i = 0; i < b.getColumn(j).getSize(); ++i)
+                result += a.getColumn(b.getColumn(j)[i].first).getSize();
+        return result;
+    }
+
+    // items are products, so hash and dense accumulators compare
+    void benchmarkProduct(BenchmarkReporter& r, std::string const& name,
+        Matrix const& a, Matrix const& b){
+        long long products = countProducts(a, b);
+        r.run("SparseMatrix multiply " + name, products, [&]{
+            doNotOptimize(Matrix::multiply(a, b).getColumns());
+        });
+        Compressed ca(a), cb(b);
+        r.run("CompressedSparseMatrix multiply " + name, products, [&]{
+            doNotOptimize(Compressed::multiply(ca, cb).getColumns());
+        });
+        // scaling from 1 to all hardware threads
+        int maxThreads = ThreadPool::defaultWorkerCount() + 1;
+        for(int threads = 1;; threads = std::min(2 * threads, maxThreads)){
+            ThreadPool pool(threads - 1);
+            r.run("SparseMatrix multiply " + name + ", " + std::to_string(threads) + " threads",
+                products, [&]{doNotOptimize(Matrix::multiply(a, b, pool).getColumns());});
+            if(threads == maxThreads) break;
+        }
+    }
+    // items are nonzeros
+    void benchmarkVectorProducts(BenchmarkReporter& r, std::string const& name,
+        Matrix const& a, bool roundTrips){
+        Compressed ca(a), rows = ca.transpose();
+        long long nonzeros = ca.getNonzeroCount();
+        Vector<double> x(a.getColumns(), 1), y(a.getRows(), 1),
+            ax(a.getRows()), ya(a.getColumns());
+        if(roundTrips){
+            // what the operators did before, through sparse vectors
+            r.run("x * SparseMatrix round trip " + name, nonzeros, [&]{doNotOptimize(
+                Matrix::sparseToDense(Matrix::denseToSparse(y) * a, a.getColumns()).getArray());});
+            Matrix::SparseVector v = Matrix::denseToSparse(x);
+            r.run("SparseMatrix * sparse x by transpose " + name, nonzeros,
+                [&]{doNotOptimize((v * a.transpose()).getSize());});
+            r.run("SparseMatrix * sparse x " + name, nonzeros,
+                [&]{doNotOptimize((a * v).getSize());});
+        }
+        r.run("x * SparseMatrix " + name, nonzeros, [&]{doNotOptimize((y * a).getArray());});
+        r.run("SparseMatrix * x " + name, nonzeros, [&]{doNotOptimize((a * x).getArray());});
+        r.run("CompressedSparseMatrix multiply " + name, nonzeros, [&]{
+            ca.multiply(x.getArray(), ax.getArray());
+            doNotOptimize(ax.getArray());
+        });
+        r.run("CompressedSparseMatrix multiplyTransposed " + name, nonzeros, [&]{
+            ca.multiplyTransposed(y.getArray(), ya.getArray());
+            doNotOptimize(ya.getArray());
+        });
+        int maxThreads = ThreadPool::defaultWorkerCount() + 1;
+        for(int threads = 1;; threads = std::min(2 * threads, maxThreads)){
+            ThreadPool pool(threads - 1);
+            r.run("CompressedSparseMatrix rows multiplyTransposed " + name + ", " +
+                std::to_string(threads) + " threads", nonzeros, [&]{
+                rows.multiplyTransposed(x.getArray(), ax.getArray(), pool);
+                doNotOptimize(ax.getArray());
+            });
+            if(threads == maxThreads) break;
+        }
+    }
+
+    // bilinear quads of a grid of m by m nodes, each adding 16 triplets
+    // into the columns of its nodes, items are triplets
+    void benchmarkAssembly(BenchmarkReporter& r, int m){
+        int cells = (m - 1) * (m - 1), n = m * m;
+        long long triplets = 16ll * cells;
+        auto assemble = [m](int cell, auto const& add){
+            int x = cell % (m - 1), y = cell / (m - 1);
+            int nodes[] = {y * m + x, y * m + x + 1, (y + 1) * m + x, (y + 1) * m + x + 1};
+            for(int i = 0; i < 4; ++i)
+                for(int j = 0; j < 4; ++j) add(nodes[i], nodes[j], i == j ? 4.0 : -1.0);
+        };
+        r.run("SparseMatrix set assembly", triplets, [&]{
+            Matrix a(n, n);
+            for(int cell = 0; cell < cells; ++cell) assemble(cell,
+                [&](int row, int column, double value){a.set(row, column, a(row, column) + value);});
+            doNotOptimize(a.getColumns());
+        });
+        r.run("TripletBuilder assembly", triplets, [&]{
+            TripletBuilder<double> builder(n, n);
+            builder.reserve(int(triplets));
+            for(int cell = 0; cell < cells; ++cell) assemble(cell,
+                [&](int row, int column, double value){builder.add(row, column, value);});
+            doNotOptimize(builder.build().getColumns());
+        });
+        int maxThreads = ThreadPool::defaultWorkerCount() + 1;
+        for(int threads = 1;; threads = std::min(2 * threads, maxThreads)){
+            ThreadPool pool(threads - 1);
+            r.run("TripletBuilder compressed assembly, " + std::to_string(threads) + " threads",
+                triplets, [&]{
+                TripletBuilder<double> builder(n, n, threads);
+                parallelFor(pool, 0, threads, 1, [&](long long t, long long){
+                    for(int cell = int(t); cell < cells; cell += threads) assemble(cell,
+                        [&](int row, int column, double value){builder.add(row, column, value, t);});
+                });
+                doNotOptimize(builder.buildCompressed(pool).getColumns());
+            });
+            if(threads == maxThreads) break;
+        }
+    }
+
+    // k triplets per column of n at random rows, in random order, about
+    // half of them repeats
+    void benchmarkRandomAssembly(BenchmarkReporter& r, int n, int k, Random<>& random){
+        int triplets = n * k;
+        Vector<int> rows(triplets), columns(triplets);
+        for(int i = 0; i < triplets; ++i){
+            rows[i] = random.mod(k);
+            columns[i] = random.mod(n);
+        }
+        std::string suffix = ", " + std::to_string(k) + " per column in random order";
+        r.run("SparseMatrix set assembly" + suffix, triplets, [&]{
+            Matrix a(k, n);
+            for(int i = 0; i < triplets; ++i) a.set(rows[i], columns[i], a(rows[i], columns[i]) + 1);
+            doNotOptimize(a.getColumns());
+        });
+        r.run("TripletBuilder assembly" + suffix, triplets, [&]{
+            TripletBuilder<double> builder(k, n);
+            builder.reserve(triplets);
+            for(int i = 0; i < triplets; ++i) builder.add(rows[i], columns[i], 1);
+            doNotOptimize(builder.build().getColumns());
+        });
+    }
+
+    // the 5 point Laplacian of an m by m grid, plus upwind convection
+    Matrix gridMatrix(int m, double convection){
+        Matrix result(m * m, m * m);
+        for(int y = 0; y < m; ++y)
+            for(int x = 0; x < m; ++x){
+                int i = y * m + x;
+                result.set(i, i, 4 + convection);
+                if(x > 0) result.set(i, i - 1, -1 - convection);
+                if(x + 1 < m) result.set(i, i + 1, -1);
+                if(y > 0) result.set(i, i - m, -1);
+                if(y + 1 < m) result.set(i, i + m, -1);
+            }
+        return result;
+    }
+
+    // items are iterations, solve is called with b and x
+    template<typename SOLVE> void benchmarkSolve(BenchmarkReporter& r, std::string const& name,
+        Vector<double> const& b, SOLVE const& solve){
+        Vector<double> x;
+        KrylovStatistics s = solve(b, x);
+        r.run(name + ", " + std::to_string(s.iterations) + " iterations", s.iterations, [&]{
+            Vector<double> x;
+            doNotOptimize(solve(b, x).iterations);
+        });
+    }
+
+    void benchmarkKrylov(BenchmarkReporter& r, int m){
+        int n = m * m;
+        Vector<double> b(n, 1), x(n, 0), p(n, 1), q(n, 1), residual(n, 1);
+        // one CG step of x and r, items are unknowns
+        r.run("CG update with Vector operators", n, [&]{
+            x += p * 0.5;
+            residual -= q * 0.5;
+            double rr = 0;
+            for(int i = 0; i < n; ++i) rr += residual[i] * residual[i];
+            doNotOptimize(rr);
+        });
+        r.run("CG update fused", n, [&]{
+            doNotOptimize(krylov::cgUpdate(0.5, p.getArray(), q.getArray(), x.getArray(),
+                residual.getArray(), n));
+        });
+        std::string suffix = " " + std::to_string(m) + "x" + std::to_string(m);
+        KrylovMatrix<double> poisson(gridMatrix(m, 0));
+        JacobiPreconditioner<double> jacobi(poisson);
+        SymmetricGaussSeidelPreconditioner<double> sgs(poisson);
+        ILU0Preconditioner<double> ilu(poisson);
+        benchmarkSolve(r, "CG Poisson" + suffix, b, [&](Vector<double> const& b,
+            Vector<double>& x){return conjugateGradient(poisson, b, x);});
+        benchmarkSolve(r, "CG Jacobi Poisson" + suffix, b, [&](Vector<double> const& b,
+            Vector<double>& x){return conjugateGradient(poisson, b, x, jacobi);});
+        benchmarkSolve(r, "CG SGS Poisson" + suffix, b, [&](Vector<double> const& b,
+            Vector<double>& x){return conjugateGradient(poisson, b, x, sgs);});
+        benchmarkSolve(r, "CG ILU(0) Poisson" + suffix, b, [&](Vector<double> const& b,
+            Vector<double>& x){return conjugateGradient(poisson, b, x, ilu);});
+        int maxThreads = ThreadPool::defaultWorkerCount() + 1;
+        if(maxThreads > 1){
+            ThreadPool pool(maxThreads - 1);
+            KrylovMatrix<double> parallel(gridMatrix(m, 0), &pool);
+            benchmarkSolve(r, "CG Poisson" + suffix + ", " + std::to_string(maxThreads) +
+                " threads", b, [&](Vector<double> const& b, Vector<double>& x)
+                {return conjugateGradient(parallel, b, x);});
+        }
+        KrylovMatrix<double> convection(gridMatrix(m, 2));
+        ILU0Preconditioner<double> convectionIlu(convection);
+        benchmarkSolve(r, "BiCGSTAB ILU(0) convection" + suffix, b, [&](Vector<double> const& b,
+            Vector<double>& x){return biCGStab(convection, b, x, convectionIlu);});
+        benchmarkSolve(r, "GMRES(30) ILU(0) convection" + suffix, b, [&](Vector<double> const& b,
+            Vector<double>& x){return gmres(convection, b, x, convectionIlu);});
+    }
+
+    // a band around the diagonal, as from a discretized operator
+    Matrix bandMatrix(int n, int width, Random<>& random){
+        Matrix result(n, n);
+        for(int c = 0; c < n; ++c)
+            for(int r = std::max(0, c - width); r <= std::min(n - 1, c + width); ++r)
+                result.set(r, c, random.uniform01());
+        return result;
+    }
+}
+
+void benchmarkSparse(BenchmarkReporter& r){
+    Random<> random(21);
+    Matrix a = randomMatrix(1 << 20, 4, random), b = randomMatrix(1 << 12, 64, random);
+    // items are nonzeros
+    long long nonzeros = Compressed(a).getNonzeroCount();
+    r.run("SparseMatrix copy and free", nonzeros, [&]{doNotOptimize(Matrix(a).getColumns());});
+    r.run("CompressedSparseMatrix from SparseMatrix", nonzeros,
+        [&]{doNotOptimize(Compressed(a).getColumns());});
+    Compressed ca(a);
+    r.run("CompressedSparseMatrix copy and free", nonzeros,
+        [&]{doNotOptimize(Compressed(ca).getColumns());});
+    r.run("SparseMatrix transpose", nonzeros, [&]{doNotOptimize(a.transpose().getColumns());});
+    r.run("CompressedSparseMatrix transpose", nonzeros,
+        [&]{doNotOptimize(ca.transpose().getColumns());});
+    benchmarkProduct(r, "4 per column", a, a);
+    benchmarkProduct(r, "64 per column", b, b);
+    benchmarkVectorProducts(r, "4K 8 per column", randomMatrix(1 << 12, 8, random), true);
+    benchmarkVectorProducts(r, "1M 8 per column", randomMatrix(1 << 20, 8, random), false);
+    benchmarkVectorProducts(r, "1M band of 27", bandMatrix(1 << 20, 13, random), false);
+    benchmarkAssembly(r, 512);
+    benchmarkRandomAssembly(r, 1 << 12, 256, random);
+    benchmarkKrylov(r, 256);
+}
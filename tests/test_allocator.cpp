@@ -0,0 +1,75 @@
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#endif
+#include "../allocator.hpp"
+#include "../vector.hpp"
+#include "../queue.hpp"
+#include "../linkedlist.hpp"
+#include "../bits.hpp"
+#include <string>
+
+TEST_CASE( "containers can allocate from an arena", "[allocator]" ) {
+    dmk::Arena arena(256);
+    dmk::ArenaAllocator a(arena);
+
+    SECTION( "vectors grow inside the arena" ) {
+        dmk::Vector<int, dmk::ArenaAllocator> v(a);
+        for(int i = 0; i < 1000; ++i) v.append(i);
+
+        REQUIRE( v.getSize() == 1000 );
+        REQUIRE( v[999] == 999 );
+        REQUIRE( arena.getReservedBytes() >= 4000 );
+    }
+    SECTION( "vectors of non trivial items grow inside the arena" ) {
+        dmk::Vector<std::string, dmk::ArenaAllocator> v(a);
+        for(int i = 0; i < 100; ++i) v.append(std::to_string(i));
+
+        REQUIRE( v[42] == "42" );
+    }
+    SECTION( "queues and lists use the arena" ) {
+        dmk::Queue<int, dmk::ArenaAllocator> q(8, a);
+        dmk::SimpleDoublyLinkedList<int, dmk::ArenaAllocator> l(a);
+        for(int i = 0; i < 100; ++i){
+            q.push(i);
+            l.append(i);
+        }
+        for(int i = 0; i < 50; ++i) REQUIRE( q.pop() == i );
+        REQUIRE( *l.begin() == 0 );
+        REQUIRE( *l.rBegin() == 99 );
+    }
+    SECTION( "reset releases everything but one block" ) {
+        for(int i = 0; i < 100; ++i) arena.allocate(1000);
+        arena.reset();
+        std::size_t reserved = arena.getReservedBytes();
+        for(int i = 0; i < 10; ++i) arena.allocate(100);
+
+        REQUIRE( arena.getReservedBytes() == reserved );
+    }
+}
+
+TEST_CASE( "pools recycle blocks by size class", "[allocator]" ) {
+    dmk::Pool pool;
+    dmk::PoolAllocator a(pool);
+
+    SECTION( "a freed block is handed out again" ) {
+        void* block = pool.allocate(24);
+        pool.deallocate(block, 24);
+
+        REQUIRE( pool.allocate(30) == block );
+    }
+    SECTION( "large blocks bypass the pool" ) {
+        void* block = pool.allocate(100000);
+        block = pool.reallocate(block, 100000, 10);
+        pool.deallocate(block, 10);
+    }
+    SECTION( "bitsets use the pool" ) {
+        dmk::Bitset<unsigned long long, dmk::PoolAllocator> b(1000, a);
+        b.set(999);
+
+        REQUIRE( b[999] );
+        REQUIRE( b.popCount() == 1 );
+    }
+}
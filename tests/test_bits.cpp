@@ -0,0 +1,223 @@
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#endif
+#include "../bits.hpp"
+#include "../rankselect.hpp"
+#include "../compressedbitmap.hpp"
+#include "../packedvector.hpp"
+#include "../random.hpp"
+
+namespace{
+    template<typename WORD>
+    dmk::Bitset<WORD> randomBitset(int n, unsigned density, dmk::Random<>& r){
+        dmk::Bitset<WORD> result(n);
+        for(int i = 0; i < n; ++i) if(r.mod(100) < density) result.set(i);
+        return result;
+    }
+
+    template<typename WORD> void checkBulkOperations(int n){
+        dmk::Random<> r(n);
+        dmk::Bitset<WORD> a = randomBitset<WORD>(n, 50, r),
+            b = randomBitset<WORD>(n, 20, r);
+        long long andCount = 0, orCount = 0, xorCount = 0, andNotCount = 0, aCount = 0;
+        for(int i = 0; i < n; ++i){
+            aCount += a[i];
+            andCount += a[i] && b[i];
+            orCount += a[i] || b[i];
+            xorCount += a[i] != b[i];
+            andNotCount += a[i] && !b[i];
+        }
+        REQUIRE( a.popCount() == aCount );
+        REQUIRE( a.popCountAnd(b) == andCount );
+        REQUIRE( a.popCountOr(b) == orCount );
+        REQUIRE( a.popCountXor(b) == xorCount );
+        REQUIRE( a.popCountAndNot(b) == andNotCount );
+
+        dmk::Bitset<WORD> c = a;
+        REQUIRE( (c &= b).popCount() == andCount );
+        c = a;
+        REQUIRE( (c |= b).popCount() == orCount );
+        c = a;
+        REQUIRE( (c ^= b).popCount() == xorCount );
+        c = a;
+        REQUIRE( c.andNot(b).popCount() == andNotCount );
+        c = a;
+        c.flip();
+        REQUIRE( c.popCount() == n - aCount );
+        for(int i = 0; i < n; ++i) REQUIRE( c[i] != a[i] );
+    }
+
+    template<int BITS> void checkPackedVector(){
+        dmk::Random<> r(BITS);
+        dmk::PackedVector<BITS> p;
+        dmk::Bitset<> b;
+        dmk::Vector<unsigned long long> values;
+        for(int i = 0; i < 1000; ++i){
+            values.append(r.next() & dmk::bits::lowerMask(BITS));
+            b.appendValue(values[i], BITS);
+            if(i < 300) p.append(values[i]);
+        }
+        p.appendValues(values.getArray() + 300, 700);
+        for(int i = 0; i < 1000; ++i){
+            REQUIRE( p[i] == values[i] );
+            REQUIRE( b.getValue(i * BITS, BITS) == values[i] );
+        }
+        // unaligned ranges with whole blocks inside
+        dmk::Vector<unsigned long long> out(700);
+        p.decode(37, 700, out.getArray());
+        for(int i = 0; i < 700; ++i) REQUIRE( out[i] == values[37 + i] );
+        for(int i = 0; i < 700; ++i) out[i] = r.next() & dmk::bits::lowerMask(BITS);
+        p.encode(101, 700, out.getArray());
+        for(int i = 0; i < 1000; ++i)
+            REQUIRE( p[i] == (i >= 101 && i < 801 ? out[i - 101] : values[i]) );
+    }
+}
+
+TEST_CASE( "word primitives match brute force", "[bits]" ) {
+    dmk::Random<> r(1);
+    for(int i = 0; i < 1000; ++i){
+        unsigned long long x = r.next() >> (1 + r.mod(63));
+        REQUIRE( dmk::popCountWord(x) == dmk::PopCount8::popCountBruteForce(x) );
+        REQUIRE( dmk::reverseBits(x) == dmk::ReverseBits8::reverseBitsBruteForce(x) );
+        REQUIRE( dmk::reverseBits((unsigned int)x) ==
+            dmk::ReverseBits8::reverseBitsBruteForce((unsigned int)x) );
+        REQUIRE( dmk::reverseBits((unsigned char)x) ==
+            dmk::ReverseBits8::reverseBitsBruteForce((unsigned char)x) );
+        if(x){
+            REQUIRE( x >> dmk::lgFloor(x) == 1 );
+            REQUIRE( dmk::nextPowerOfTwo(x) >= x );
+            REQUIRE( dmk::isPowerOfTwo(dmk::nextPowerOfTwo(x)) );
+        }
+    }
+    static_assert(dmk::lgCeiling(1000) == 10, "");
+    static_assert(dmk::reverseBits<unsigned short>(1) == 0x8000, "");
+
+    int sizes[] = {1, 64, 65, 1000};
+    for(int n : sizes){
+        dmk::Bitset<> b = randomBitset<unsigned long long>(n, 30, r), reversed = b;
+        reversed.reverse();
+        for(int i = 0; i < n; ++i) REQUIRE( reversed[i] == b[n - 1 - i] );
+    }
+}
+
+TEST_CASE( "bitset bulk operations match bit by bit results", "[bits]" ) {
+    int sizes[] = {1, 63, 64, 65, 255, 4096, 4096 + 64 * 5 + 17, 100000};
+    for(int n : sizes){
+        checkBulkOperations<unsigned long long>(n);
+        checkBulkOperations<unsigned long>(n);
+        checkBulkOperations<unsigned int>(n);
+    }
+}
+
+TEST_CASE( "packed vectors store values of any width", "[bits]" ) {
+    checkPackedVector<1>();
+    checkPackedVector<3>();
+    checkPackedVector<17>();
+    checkPackedVector<32>();
+    checkPackedVector<63>();
+    checkPackedVector<64>();
+}
+
+TEST_CASE( "rank and select agree with counting", "[bits]" ) {
+    dmk::Random<> r(1);
+    int sizes[] = {1, 2048, 2049, 50000};
+    for(int n : sizes){
+        dmk::Bitset<> b = randomBitset<unsigned long long>(n, 30, r);
+        dmk::RankSelect rs(b);
+        unsigned long long ones = 0, zeros = 0;
+        for(int i = 0; i < n; ++i){
+            REQUIRE( rs.rank1(i) == ones );
+            if(b[i]) REQUIRE( rs.select1(ones++) == (unsigned long long)i );
+            else REQUIRE( rs.select0(zeros++) == (unsigned long long)i );
+        }
+        REQUIRE( rs.rank1(n) == rs.getOnes() );
+        REQUIRE( rs.rank0(n) == zeros );
+    }
+}
+
+TEST_CASE( "set bits can be searched and enumerated", "[bits]" ) {
+    dmk::Bitset<> b(1000);
+    int members[] = {3, 64, 65, 500, 999};
+    for(int i : members) b.set(i);
+
+    REQUIRE( b.nextSetBit(0) == 3 );
+    REQUIRE( b.nextSetBit(66) == 500 );
+    REQUIRE( b.prevSetBit(499) == 65 );
+    REQUIRE( b.prevSetBit(2) == -1 );
+    REQUIRE( b.nextClearBit(64) == 66 );
+
+    dmk::Vector<int> visited, iterated;
+    b.forEachSetBit([&](unsigned long long i){visited.append(i);});
+    for(unsigned long long i : b.setBits()) iterated.append(i);
+    REQUIRE( visited.getSize() == 5 );
+    REQUIRE( visited == iterated );
+    for(int i = 0; i < 5; ++i) REQUIRE( visited[i] == members[i] );
+
+    b.setAll();
+    REQUIRE( b.nextClearBit(0) == -1 );
+    REQUIRE( b.setBits().begin() != b.setBits().end() );
+}
+
+TEST_CASE( "compressed bitmaps match dense bitsets", "[bits]" ) {
+    // a sparse chunk, a dense chunk and a chunk of long runs
+    dmk::Random<> r(2);
+    dmk::Bitset<> dense(1 << 18), other(1 << 18);
+    for(int i = 0; i < 1000; ++i) dense.set(r.mod(1 << 16));
+    for(int i = 0; i < 30000; ++i) dense.set((1 << 16) + r.mod(1 << 16));
+    for(int i = 0; i < 1 << 16; ++i) if(i % 5000 < 3000) dense.set((2 << 16) + i);
+    for(int i = 0; i < 1 << 18; ++i) if(r.mod(10) == 0) other.set(i);
+
+    dmk::CompressedBitmap a(dense), b(other);
+    a.runOptimize();
+    REQUIRE( a.getCardinality() == (unsigned long long)dense.popCount() );
+    REQUIRE( a.toBitset(1 << 18) == dense );
+
+    dmk::Bitset<> expected = dense;
+    REQUIRE( (a & b).toBitset(1 << 18) == (expected &= other) );
+    expected = dense;
+    REQUIRE( (a | b).toBitset(1 << 18) == (expected |= other) );
+    expected = dense;
+    REQUIRE( (a ^ b).toBitset(1 << 18) == (expected ^= other) );
+    expected = dense;
+    REQUIRE( dmk::CompressedBitmap(a).andNot(b).toBitset(1 << 18) == expected.andNot(other) );
+
+    REQUIRE( a.add(3 << 16) );
+    REQUIRE( a.contains(3 << 16) );
+    REQUIRE( a.remove(3 << 16) );
+    REQUIRE( a.toBitset(1 << 18) == dense );
+
+    // run chunks against runs, arrays and bitmaps of a, and in chunk 3
+    // against runs that interleave and touch their own
+    dmk::Bitset<> runs(1 << 18), touching(1 << 18);
+    for(int i = 0; i < 3 << 16; ++i) if(i % 2000 < 700) runs.set(i);
+    for(int i = 0; i < 1 << 16; ++i){
+        if(i % 200 < 100) runs.set((3 << 16) + i);
+        else touching.set((3 << 16) + i);
+        if(i % 3000 < 1500) touching.set((2 << 16) + i);
+    }
+    dmk::CompressedBitmap c(runs), d(touching);
+    c.runOptimize();
+    d.runOptimize();
+    struct Pair{
+        dmk::CompressedBitmap const* x;
+        dmk::Bitset<> const* dx;
+    } pairs[] = {{&a, &dense}, {&b, &other}, {&d, &touching}};
+    for(Pair const& pair : pairs){
+        dmk::CompressedBitmap const& x = *pair.x;
+        expected = runs;
+        REQUIRE( (c & x).toBitset(1 << 18) == (expected &= *pair.dx) );
+        expected = runs;
+        REQUIRE( (c | x).toBitset(1 << 18) == (expected |= *pair.dx) );
+        expected = runs;
+        REQUIRE( (c ^ x).toBitset(1 << 18) == (expected ^= *pair.dx) );
+        expected = runs;
+        REQUIRE( dmk::CompressedBitmap(c).andNot(x).toBitset(1 << 18) ==
+            expected.andNot(*pair.dx) );
+        expected = *pair.dx;
+        REQUIRE( dmk::CompressedBitmap(x).andNot(c).toBitset(1 << 18) ==
+            expected.andNot(runs) );
+    }
+}
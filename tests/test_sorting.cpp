@@ -0,0 +1,403 @@
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#endif
+#include "../sorting.hpp"
+#include "../externalsort.hpp"
+#include "../staticsearch.hpp"
+#include "../random.hpp"
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+namespace{
+    typedef std::pair<int, int> Item; // key and original position
+
+    dmk::Vector<Item> randomItems(int n, int keys, dmk::Random<>& r){
+        dmk::Vector<Item> result;
+        for(int i = 0; i < n; ++i) result.append(Item(r.mod(keys), i));
+        return result;
+    }
+}
+
+TEST_CASE( "parallel sorts match the sequential ones", "[sorting]" ) {
+    dmk::Random<> r(3);
+    dmk::PairFirstComparator<int, int> byKey;
+    int workerCounts[] = {0, 1, 3}, sizes[] = {0, 1, 100, 5000, 100000};
+    for(int workers : workerCounts){
+        dmk::ThreadPool pool(workers);
+        for(int n : sizes){
+            // few distinct keys, so stability matters
+            dmk::Vector<Item> items = randomItems(n, 1 + n / 10, r),
+                expected = items, sorted = items;
+            dmk::mergeSort(expected.getArray(), n, byKey);
+            dmk::mergeSort(sorted.getArray(), n, byKey, pool, 64);
+            REQUIRE( sorted == expected );
+
+            dmk::Vector<int> keys(n), expectedKeys;
+            for(int i = 0; i < n; ++i) keys[i] = items[i].first;
+            expectedKeys = keys;
+            std::sort(expectedKeys.getArray(), expectedKeys.getArray() + n);
+            dmk::quickSort(keys.getArray(), 0, n - 1, dmk::DefaultComparator<int>(), pool, 64);
+            REQUIRE( keys == expectedKeys );
+        }
+    }
+}
+
+namespace{
+    template<typename KEY> void checkRadixSort(dmk::Vector<KEY> keys, dmk::ThreadPool& pool){
+        dmk::Vector<KEY> expected = keys, parallel = keys;
+        std::sort(expected.getArray(), expected.getArray() + keys.getSize());
+        dmk::radixSort(keys.getArray(), keys.getSize());
+        REQUIRE( keys == expected );
+        dmk::RadixSorter<KEY>().sort(parallel.getArray(), parallel.getSize(), pool);
+        REQUIRE( parallel == expected );
+    }
+
+    struct ItemKey{int operator()(Item const& item)const{return item.first;}};
+}
+
+TEST_CASE( "radix sort orders integers, floats and records", "[sorting]" ) {
+    dmk::Random<> r(4);
+    dmk::ThreadPool pool(3);
+    int sizes[] = {0, 1, 1000, 200000};
+    for(int n : sizes){
+        dmk::Vector<int> ints;
+        dmk::Vector<unsigned long long> longs;
+        dmk::Vector<float> floats;
+        dmk::Vector<double> doubles;
+        dmk::Vector<unsigned short> shorts; // some passes are skipped
+        for(int i = 0; i < n; ++i){
+            ints.append(int(r.next()));
+            longs.append(r.next() >> r.mod(64));
+            floats.append(float(r.uniform01() - 0.5) * r.mod(1000));
+            doubles.append((r.uniform01() - 0.5) * r.mod(1000000));
+            shorts.append(r.mod(100));
+        }
+        checkRadixSort(ints, pool);
+        checkRadixSort(longs, pool);
+        checkRadixSort(floats, pool);
+        checkRadixSort(doubles, pool);
+        checkRadixSort(shorts, pool);
+
+        // stable by key, negative keys first
+        dmk::Vector<Item> items = randomItems(n, 1 + n / 10, r), expected, parallel;
+        for(int i = 0; i < n; ++i) items[i].first -= n / 20;
+        expected = parallel = items;
+        dmk::mergeSort(expected.getArray(), n, dmk::PairFirstComparator<int, int>());
+        dmk::radixSort(items.getArray(), n, ItemKey());
+        REQUIRE( items == expected );
+        dmk::RadixSorter<Item, ItemKey> sorter;
+        sorter.sort(parallel.getArray(), n, pool);
+        REQUIRE( parallel == expected );
+    }
+}
+
+TEST_CASE( "pdqSort and heapSort handle common patterns", "[sorting]" ) {
+    dmk::Random<> r(5);
+    int n = 50000;
+    dmk::Vector<dmk::Vector<int> > inputs(6);
+    for(int i = 0; i < n; ++i){
+        inputs[0].append(r.next());             // random
+        inputs[1].append(i);                    // sorted
+        inputs[2].append(n - i);                // reversed
+        inputs[3].append(r.mod(4));             // few distinct
+        inputs[4].append(i < n / 2 ? i : n - i); // organ pipe
+        inputs[5].append(i % 100 ? i : r.mod(n)); // nearly sorted
+    }
+    for(int k = 0; k < inputs.getSize(); ++k){
+        dmk::Vector<int> expected = inputs[k], pdq = inputs[k], heap = inputs[k];
+        std::sort(expected.getArray(), expected.getArray() + n);
+        dmk::pdqSort(pdq.getArray(), n);
+        REQUIRE( pdq == expected );
+        dmk::heapSort(heap.getArray(), 0, n - 1, dmk::DefaultComparator<int>());
+        REQUIRE( heap == expected );
+    }
+    // small sizes around the insertion sort and ninther thresholds
+    for(int m = 0; m < 300; ++m){
+        dmk::Vector<int> v, expected;
+        for(int i = 0; i < m; ++i) v.append(r.mod(m / 2 + 1));
+        expected = v;
+        std::sort(expected.getArray(), expected.getArray() + m);
+        dmk::pdqSort(v.getArray(), m);
+        REQUIRE( v == expected );
+    }
+}
+
+namespace{
+    struct Record{
+        long long key;
+        char payload[56];
+        bool operator<(Record const& rhs)const{return key < rhs.key;}
+    };
+}
+
+TEST_CASE( "external sort merges spilled runs", "[sorting]" ) {
+    dmk::Random<> r(6);
+    // in memory, one run, 5 runs in full passes of 3, and 6 runs of which
+    // the first pass merges 2
+    int sizes[] = {0, 1000, 300000, 350000};
+    for(int n : sizes){
+        dmk::ExternalSorter<Record> sorter(1 << 22);
+        dmk::Vector<long long> expected;
+        for(int i = 0; i < n; ++i){
+            Record record = {(long long)r.mod(1000000), {}};
+            record.payload[0] = char(record.key);
+            sorter.append(record);
+            expected.append(record.key);
+        }
+        sorter.finish();
+        REQUIRE( (n < 300000 || sorter.getRunCount() == 3) );
+        std::sort(expected.getArray(), expected.getArray() + n);
+        int i = 0;
+        for(Record const& record : sorter){
+            REQUIRE( i < n );
+            REQUIRE( record.key == expected[i++] );
+            REQUIRE( record.payload[0] == char(record.key) );
+        }
+        REQUIRE( i == n );
+    }
+}
+
+TEST_CASE( "static search layouts agree with lower bound", "[sorting]" ) {
+    dmk::Random<> r(7);
+    int sizes[] = {0, 1, 2, 15, 16, 17, 271, 272, 273, 5000, 100000};
+    for(int n : sizes){
+        dmk::Vector<int> keys;
+        for(int i = 0; i < n; ++i) keys.append(r.mod(3 * n + 1));
+        std::sort(keys.getArray(), keys.getArray() + n);
+        dmk::EytzingerSearch<int> eytzinger(keys.getArray(), n);
+        dmk::StaticBTree<int> tree(keys.getArray(), n);
+        dmk::StaticBTree<long long> wideTree(dmk::Vector<long long>(n).getArray(), 0);
+        REQUIRE( wideTree.lowerBound(5) == 0 );
+        dmk::Vector<int> queries;
+        for(int i = 0; i < 1000; ++i) queries.append(int(r.mod(3 * n + 3)) - 1);
+        dmk::Vector<int> fromEytzinger(queries.getSize()), fromTree(queries.getSize());
+        eytzinger.lowerBounds(queries.getArray(), queries.getSize(), fromEytzinger.getArray());
+        tree.lowerBounds(queries.getArray(), queries.getSize(), fromTree.getArray());
+        for(int i = 0; i < queries.getSize(); ++i){
+            int q = queries[i], expected = int(std::lower_bound(keys.getArray(),
+                keys.getArray() + n, q) - keys.getArray());
+            REQUIRE( eytzinger.lowerBound(q) == expected );
+            REQUIRE( tree.lowerBound(q) == expected );
+            REQUIRE( fromEytzinger[i] == expected );
+            REQUIRE( fromTree[i] == expected );
+            bool found = expected < n && keys[expected] == q;
+            REQUIRE( (eytzinger.find(q) == -1) == !found );
+            REQUIRE( (tree.find(q) == -1) == !found );
+            if(found) REQUIRE( keys[eytzinger.find(q)] == q );
+        }
+    }
+    // the generic node search
+    dmk::Vector<double> keys;
+    for(int i = 0; i < 1000; ++i) keys.append(i / 2);
+    dmk::StaticBTree<double> tree(keys.getArray(), keys.getSize());
+    dmk::EytzingerSearch<double> eytzinger(keys.getArray(), keys.getSize());
+    for(int i = -1; i <= 501; ++i){
+        int expected = std::max(0, std::min(1000, 2 * i));
+        REQUIRE( tree.lowerBound(i) == expected );
+        REQUIRE( eytzinger.lowerBound(i) == expected );
+    }
+}
+
+namespace{
+    template<typename ITEM> void checkNetworks(dmk::Random<>& r){
+        for(int n = 0; n <= 70; ++n){
+            ITEM items[70], expected[70];
+            for(int i = 0; i < n; ++i)
+                items[i] = expected[i] = ITEM(r.mod(40)) - ITEM(r.mod(3) ? 0 : 20);
+            std::sort(expected, expected + n);
+            if(n <= dmk::SORTING_NETWORK_MAX){
+                ITEM copy[70];
+                std::copy(items, items + n, copy);
+                dmk::networkSort(copy, n);
+                REQUIRE( std::equal(copy, copy + n, expected) );
+            }
+            dmk::sortSmall(items, n);
+            REQUIRE( std::equal(items, items + n, expected) );
+        }
+    }
+}
+
+TEST_CASE( "sorting networks match std::sort", "[sorting]" ) {
+    dmk::Random<> r(8);
+    for(int i = 0; i < 20; ++i){
+        checkNetworks<int>(r);
+        checkNetworks<unsigned>(r);
+        checkNetworks<long long>(r);
+        checkNetworks<unsigned long long>(r);
+        checkNetworks<float>(r);
+        checkNetworks<double>(r);
+        checkNetworks<short>(r);
+    }
+    std::pair<long long, int> pairs[20];
+    for(int i = 0; i < 20; ++i) pairs[i] = std::make_pair(r.mod(4), int(r.mod(4)));
+    dmk::networkSort(pairs, 20);
+    REQUIRE( std::is_sorted(pairs, pairs + 20) );
+
+    // +0 and -0 are equal but not the same, mergeSort keeps their order
+    dmk::ThreadPool pool(1);
+    for(int n : {8, 16, 1000}){
+        dmk::Vector<double> zeros(n), sorted, expected;
+        for(int i = 0; i < n; ++i) zeros[i] = r.mod(4) == 0 ? 1 : r.mod(2) ? 0.0 : -0.0;
+        expected = zeros;
+        std::stable_sort(expected.getArray(), expected.getArray() + n);
+        for(int parallel = 0; parallel < 2; ++parallel){
+            sorted = zeros;
+            if(parallel) dmk::mergeSort(sorted.getArray(), n, dmk::DefaultComparator<double>(),
+                pool, 16);
+            else dmk::mergeSort(sorted.getArray(), n, dmk::DefaultComparator<double>());
+            for(int i = 0; i < n; ++i)
+                REQUIRE( std::signbit(sorted[i]) == std::signbit(expected[i]) );
+        }
+    }
+}
+
+TEST_CASE( "selection finds the k smallest items", "[sorting]" ) {
+    dmk::Random<> r(9);
+    dmk::DefaultComparator<int> c;
+    for(int n : {1, 2, 17, 100, 1000, 20000}){
+        for(int keys : {2, n}){
+            dmk::Vector<int> input;
+            for(int i = 0; i < n; ++i) input.append(r.mod(keys));
+            dmk::Vector<int> expected = input;
+            std::sort(expected.getArray(), expected.getArray() + n);
+            for(int k : {0, n / 3, n - 1}){
+                dmk::Vector<int> v = input;
+                dmk::nthElement(v.getArray(), 0, n - 1, k, c);
+                REQUIRE( v[k] == expected[k] );
+                for(int i = 0; i < n; ++i) REQUIRE( (i < k ? !(v[k] < v[i]) : !(v[i] < v[k])) );
+                v = input; // the worst case fallback
+                dmk::linearSelect(v.getArray(), 0, n - 1, k, c);
+                REQUIRE( v[k] == expected[k] );
+            }
+            for(int k : {0, 1, n / 2, n}){
+                dmk::Vector<int> v = input;
+                dmk::partialSort(v.getArray(), 0, n - 1, k, c);
+                REQUIRE( std::equal(v.getArray(), v.getArray() + k, expected.getArray()) );
+                dmk::Vector<int> top = dmk::topK(input.getArray(), n, k, c);
+                REQUIRE( top.getSize() == k );
+                REQUIRE( std::equal(top.getArray(), top.getArray() + k, expected.getArray()) );
+            }
+        }
+    }
+    dmk::ThreadPool pool(3);
+    dmk::Vector<int> input;
+    for(int i = 0; i < 300000; ++i) input.append(r.next());
+    dmk::ReverseComparator<int> largest;
+    dmk::Vector<int> top = dmk::topK(input.getArray(), input.getSize(), 100, largest, pool, 1000);
+    std::sort(input.getArray(), input.getArray() + input.getSize(), largest);
+    REQUIRE( top.getSize() == 100 );
+    REQUIRE( std::equal(top.getArray(), top.getArray() + 100, input.getArray()) );
+}
+
+TEST_CASE( "powerSort is stable and adapts to runs", "[sorting]" ) {
+    dmk::Random<> r(10);
+    dmk::PairFirstComparator<int, int> byKey;
+    dmk::Vector<Item> scratch; // reused by all sorts
+    for(int n : {0, 1, 2, 23, 24, 25, 1000, 100000}){
+        dmk::Vector<Item> random = randomItems(n, 1 + n / 10, r), sorted = random,
+            reversed, runs, nearlySorted;
+        std::stable_sort(sorted.getArray(), sorted.getArray() + n, byKey);
+        for(int i = n - 1; i >= 0; --i) reversed.append(Item(sorted[i].first, i));
+        for(int i = 0; i < n; ++i){
+            runs.append(Item(i % (1 + n / 7), i)); // several ascending runs
+            nearlySorted.append(Item(r.mod(100) ? i : int(r.mod(n)), i));
+        }
+        for(dmk::Vector<Item>* input : {&random, &sorted, &reversed, &runs, &nearlySorted}){
+            dmk::Vector<Item> expected = *input, items = *input;
+            std::stable_sort(expected.getArray(), expected.getArray() + n, byKey);
+            dmk::powerSort(items.getArray(), n, byKey, scratch);
+            REQUIRE( items == expected );
+        }
+    }
+}
+
+namespace{
+    struct Wide{
+        int key;
+        float weight;
+        std::string name;
+        char payload[64];
+    };
+}
+
+TEST_CASE( "argSort permutations reorder records", "[sorting]" ) {
+    dmk::Random<> r(11);
+    for(int n : {0, 1, 1000}){
+        dmk::Vector<Wide> records;
+        for(int i = 0; i < n; ++i){
+            Wide w = {int(r.mod(50)), float(r.uniform01()), std::to_string(r.mod(100)), {}};
+            w.payload[0] = char(i);
+            records.append(w);
+        }
+        dmk::Vector<int> byKey = dmk::argSort(records.getArray(), n,
+            [](Wide const& w){return w.key;});
+        dmk::Vector<int> byWeight = dmk::argSort(records.getArray(), n,
+            [](Wide const& w){return w.weight;});
+        dmk::Vector<int> byName = dmk::argSort(records.getArray(), n,
+            [](Wide const& w){return w.name;});
+        for(int i = 1; i < n; ++i){
+            Wide const &a = records[byKey[i - 1]], &b = records[byKey[i]];
+            REQUIRE( (a.key < b.key || (a.key == b.key && byKey[i - 1] < byKey[i])) );
+            REQUIRE( records[byWeight[i - 1]].weight <= records[byWeight[i]].weight );
+            std::string const &x = records[byName[i - 1]].name, &y = records[byName[i]].name;
+            REQUIRE( (x < y || (x == y && byName[i - 1] < byName[i])) );
+        }
+        dmk::Vector<Wide> reordered = records;
+        dmk::Vector<int> permutation = byName;
+        dmk::applyPermutation(reordered.getArray(), n, permutation.getArray());
+        REQUIRE( permutation == byName );
+        for(int i = 0; i < n; ++i){
+            REQUIRE( reordered[i].name == records[byName[i]].name );
+            REQUIRE( reordered[i].payload[0] == records[byName[i]].payload[0] );
+        }
+    }
+}
+
+TEST_CASE( "string sorts match comparison sorting", "[sorting]" ) {
+    typedef dmk::Vector<char> String;
+    dmk::Random<> r(13);
+    char const* prefixes[] = {"", "http://", "http://www.", "/usr/lib/"};
+    char alphabet[] = {'a', 'b', '/', '.', char(-3), 0};
+    dmk::LexicographicComparator<String> c;
+    for(int n : {0, 1, 50, 5000}){
+        dmk::Vector<String> strings;
+        dmk::Vector<dmk::Vector<int> > numbers;
+        for(int i = 0; i < n; ++i){
+            String s;
+            for(char const* p = prefixes[r.mod(4)]; *p; ++p) s.append(*p);
+            for(int j = r.mod(12); j > 0; --j) s.append(alphabet[r.mod(6)]);
+            strings.append(s);
+            dmk::Vector<int> x;
+            for(int j = r.mod(4); j > 0; --j) x.append(int(r.mod(5)) - 2);
+            numbers.append(x);
+        }
+        dmk::Vector<String> expected = strings, multikey = strings, radix = strings;
+        std::sort(expected.getArray(), expected.getArray() + n, c);
+        dmk::multikeyQuickSort(multikey.getArray(), n);
+        dmk::msdRadixSort(radix.getArray(), n);
+        REQUIRE( multikey == expected );
+        REQUIRE( radix == expected );
+        dmk::Vector<dmk::Vector<int> > sortedNumbers = numbers;
+        std::sort(numbers.getArray(), numbers.getArray() + n,
+            dmk::LexicographicComparator<dmk::Vector<int> >());
+        dmk::multikeyQuickSort(sortedNumbers.getArray(), n);
+        REQUIRE( sortedNumbers == numbers );
+    }
+    // each key a prefix of the next, the radix sort goes a byte deeper per key
+    int n = 6000;
+    dmk::Vector<String> nested(n), expected(n);
+    for(int i = 0; i < n; ++i){
+        expected[i] = String(i + 1, 'a');
+        nested[i] = expected[i];
+    }
+    for(int i = n - 1; i > 0; --i) std::swap(nested[i], nested[r.mod(i + 1)]);
+    dmk::Vector<String> radix = nested;
+    dmk::msdRadixSort(radix.getArray(), n);
+    dmk::multikeyQuickSort(nested.getArray(), n);
+    REQUIRE( radix == expected );
+    REQUIRE( nested == expected );
+}
@@ -0,0 +1,311 @@
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#endif
+#include "../sparse.hpp"
+#include "../compressedsparse.hpp"
+#include "../krylov.hpp"
+#include "../random.hpp"
+
+namespace{
+    typedef dmk::SparseMatrix<double> Matrix;
+
+    // small integer values, so that sums in any order are exact
+    Matrix randomMatrix(int rows, int columns, int maxPerColumn, dmk::Random<>& r){
+        Matrix result(rows, columns);
+        for(int c = 0; c < columns; ++c)
+            for(int j = r.mod(maxPerColumn + 1); j > 0; --j)
+                result.set(r.mod(rows), c, double(int(r.mod(7)) - 3));
+        return result;
+    }
+
+    dmk::Vector<double> denseProduct(Matrix const& a, Matrix const& b){
+        dmk::Vector<double> result(a.getRows() * b.getColumns(), 0);
+        for(int j = 0; j < b.getColumns(); ++j)
+            for(int i = 0; i < b.getColumn(j).getSize(); ++i){
+                int k = b.getColumn(j)[i].first;
+                for(int t = 0; t < a.getColumn(k).getSize(); ++t)
+                    result[j * a.getRows() + a.getColumn(k)[t].first] +=
+                        a.getColumn(k)[t].second * b.getColumn(j)[i].second;
+            }
+        return result;
+    }
+
+    void requireProduct(Matrix const& c, dmk::Vector<double> const& expected){
+        for(int j = 0; j < c.getColumns(); ++j){
+            Matrix::SparseVector const& column = c.getColumn(j);
+            int stored = 0;
+            for(int i = 0; i < column.getSize(); ++i){
+                REQUIRE( (i == 0 || column[i - 1].first < column[i].first) );
+                REQUIRE( column[i].second != 0 );
+            }
+            for(int r = 0; r < c.getRows(); ++r){
+                double x = expected[j * c.getRows() + r];
+                if(x != 0) ++stored;
+                REQUIRE( c(r, j) == x );
+            }
+            REQUIRE( column.getSize() == stored );
+        }
+    }
+}
+
+TEST_CASE( "sparse products match dense products", "[sparse]" ) {
+    dmk::Random<> r(17);
+    dmk::ThreadPool pool(2);
+    // few products per column for the hash accumulator, more for the
+    // dense one, sorted or scanned
+    Matrix a = randomMatrix(2000, 300, 4, r), b = randomMatrix(300, 120, 3, r),
+        medium = randomMatrix(300, 40, 120, r), wide = randomMatrix(300, 40, 250, r);
+    for(Matrix const* rhs : {&b, &medium, &wide}){
+        dmk::Vector<double> expected = denseProduct(a, *rhs);
+        requireProduct(Matrix::multiply(a, *rhs), expected);
+        requireProduct(Matrix::multiply(a, *rhs, pool), expected);
+        requireProduct(a * *rhs, expected);
+    }
+    Matrix empty(300, 0);
+    REQUIRE( Matrix::multiply(a, empty, pool).getColumns() == 0 );
+}
+
+TEST_CASE( "compressed columns match SparseMatrix", "[sparse]" ) {
+    typedef dmk::CompressedSparseMatrix<double> Compressed;
+    dmk::Random<> r(19);
+    dmk::ThreadPool pool(2);
+    Matrix a = randomMatrix(500, 80, 12, r), b = randomMatrix(80, 60, 30, r);
+    Compressed ca(a), cb(b), empty(Matrix(3, 0));
+    REQUIRE( ca.getNonzeroCount() == ca.getStarts()[ca.getColumns()] );
+    REQUIRE( empty.getColumns() == 0 );
+    Matrix back = ca.toSparseMatrix();
+    double maxRowSum = 0;
+    for(int i = 0; i < a.getRows(); ++i){
+        double rowSum = 0;
+        for(int j = 0; j < a.getColumns(); ++j){
+            REQUIRE( ca(i, j) == a(i, j) );
+            REQUIRE( back(i, j) == a(i, j) );
+            rowSum += std::abs(a(i, j));
+        }
+        maxRowSum = std::max(maxRowSum, rowSum);
+    }
+    REQUIRE( normInf(ca) == maxRowSum );
+    REQUIRE( normInf(a) == maxRowSum );
+    for(int j = 0; j < a.getColumns(); ++j){
+        REQUIRE( ca.getColumn(j).getSize() == a.getColumn(j).getSize() );
+        for(int i = 0; i < a.getColumn(j).getSize(); ++i)
+            REQUIRE( ca.getColumn(j)[i] == a.getColumn(j)[i] );
+    }
+    Compressed t = ca.transpose();
+    for(int i = 0; i < a.getRows(); ++i)
+        for(int j = 0; j < a.getColumns(); ++j) REQUIRE( t(j, i) == a(i, j) );
+
+    dmk::Vector<double> x(a.getColumns()), y(a.getRows());
+    for(int j = 0; j < x.getSize(); ++j) x[j] = int(r.mod(5)) - 2;
+    for(int i = 0; i < y.getSize(); ++i) y[i] = int(r.mod(5)) - 2;
+    dmk::Vector<double> ax = ca * x, ya = y * ca;
+    for(int i = 0; i < a.getRows(); ++i){
+        double sum = 0;
+        for(int j = 0; j < a.getColumns(); ++j) sum += a(i, j) * x[j];
+        REQUIRE( ax[i] == sum );
+    }
+    for(int j = 0; j < a.getColumns(); ++j){
+        double sum = 0;
+        for(int i = 0; i < a.getRows(); ++i) sum += y[i] * a(i, j);
+        REQUIRE( ya[j] == sum );
+    }
+
+    Matrix product = Matrix::multiply(a, b);
+    for(Compressed const& c : {ca * cb, Compressed::multiply(ca, cb, pool)})
+        for(int j = 0; j < product.getColumns(); ++j){
+            REQUIRE( c.getColumn(j).getSize() == product.getColumn(j).getSize() );
+            for(int i = 0; i < product.getColumn(j).getSize(); ++i)
+                REQUIRE( c.getColumn(j)[i] == product.getColumn(j)[i] );
+        }
+}
+
+TEST_CASE( "sparse matrix vector products agree", "[sparse]" ) {
+    dmk::Random<> r(23);
+    dmk::ThreadPool pool(3);
+    // long columns for the vector gathers, many for the partitioning
+    Matrix a = randomMatrix(300, 20000, 40, r);
+    dmk::CompressedSparseMatrix<double> ca(a), rows = ca.transpose();
+    dmk::Vector<int> starts(ca.getColumns() + 1), indices(ca.getNonzeroCount());
+    dmk::Vector<float> values(ca.getNonzeroCount());
+    for(int j = 0; j < starts.getSize(); ++j) starts[j] = ca.getStarts()[j];
+    for(int i = 0; i < values.getSize(); ++i){
+        indices[i] = ca.getRowIndices()[i];
+        values[i] = float(ca.getValues()[i]);
+    }
+    dmk::CompressedSparseMatrix<float> cf(300, std::move(starts), std::move(indices),
+        std::move(values));
+    dmk::Vector<double> x(a.getColumns()), y(a.getRows());
+    for(int j = 0; j < x.getSize(); ++j) x[j] = int(r.mod(5)) - 2;
+    for(int i = 0; i < y.getSize(); ++i) y[i] = int(r.mod(5)) - 2;
+    dmk::Vector<double> ax(a.getRows(), 0), ya(a.getColumns(), 0);
+    for(int j = 0; j < a.getColumns(); ++j)
+        for(int i = 0; i < a.getColumn(j).getSize(); ++i){
+            std::pair<int, double> item = a.getColumn(j)[i];
+            ax[item.first] += item.second * x[j];
+            ya[j] += item.second * y[item.first];
+        }
+    REQUIRE( a * x == ax );
+    REQUIRE( y * a == ya );
+    REQUIRE( ca * x == ax );
+    REQUIRE( y * ca == ya );
+    dmk::Vector<double> result(a.getRows());
+    rows.multiplyTransposed(x.getArray(), result.getArray(), pool);
+    REQUIRE( result == ax );
+    result = dmk::Vector<double>(a.getColumns());
+    ca.multiplyTransposed(y.getArray(), result.getArray(), pool);
+    REQUIRE( result == ya );
+    dmk::Vector<float> yf(300), expected(cf.getColumns(), 0), resultf(cf.getColumns());
+    for(int i = 0; i < yf.getSize(); ++i) yf[i] = int(r.mod(5)) - 2;
+    for(int j = 0; j < cf.getColumns(); ++j)
+        for(int i = 0; i < cf.getColumn(j).getSize(); ++i)
+            expected[j] += cf.getColumn(j)[i].second * yf[cf.getColumn(j)[i].first];
+    cf.multiplyTransposed(yf.getArray(), resultf.getArray(), pool);
+    REQUIRE( resultf == expected );
+
+    Matrix::SparseVector v = Matrix::denseToSparse(x), av = a * v;
+    REQUIRE( Matrix::sparseToDense(av, a.getRows()) == ax );
+}
+
+TEST_CASE( "triplet assembly sums repeats", "[sparse]" ) {
+    dmk::Random<> r(29);
+    dmk::ThreadPool pool(3);
+    for(int n : {0, 1, 20000}){
+        int rows = 50, columns = 70;
+        dmk::TripletBuilder<double> builder(rows, columns, 4);
+        dmk::Vector<double> expected(rows * columns, 0);
+        for(int i = 0; i < n; ++i){
+            // few distinct items, so most repeat and some cancel
+            int row = r.mod(rows), column = r.mod(columns / 2) * 2;
+            double value = double(int(r.mod(5)) - 2);
+            builder.add(row, column, value, i % 4);
+            expected[column * rows + row] += value;
+        }
+        REQUIRE( builder.getSize() == n );
+        dmk::CompressedSparseMatrix<double> sequential = builder.buildCompressed(),
+            parallel = builder.buildCompressed(pool);
+        Matrix matrix = builder.build(pool);
+        int nonzeros = 0;
+        for(int column = 0; column < columns; ++column)
+            for(int row = 0; row < rows; ++row){
+                double x = expected[column * rows + row];
+                nonzeros += x != 0;
+                REQUIRE( sequential(row, column) == x );
+                REQUIRE( parallel(row, column) == x );
+                REQUIRE( matrix(row, column) == x );
+            }
+        REQUIRE( sequential.getNonzeroCount() == nonzeros );
+        REQUIRE( parallel.getNonzeroCount() == nonzeros );
+        for(int column = 0; column <= columns; ++column)
+            REQUIRE( parallel.getStarts()[column] == sequential.getStarts()[column] );
+    }
+    // many lists and columns for a few triplets, the count tables would
+    // take lists * columns ints if they didn't depend on the triplets
+    dmk::TripletBuilder<double> wide(3, 1 << 22, 1 << 10);
+    wide.add(2, (1 << 22) - 1, 1, 1000);
+    wide.add(0, 5, 2, 3);
+    wide.add(2, (1 << 22) - 1, 1, 0);
+    dmk::CompressedSparseMatrix<double> w = wide.buildCompressed(pool);
+    REQUIRE( w.getNonzeroCount() == 2 );
+    REQUIRE( w(2, (1 << 22) - 1) == 2 );
+    REQUIRE( w(0, 5) == 2 );
+}
+
+namespace{
+    // the 5 point Laplacian of an m by m grid, plus upwind convection
+    // along x, which makes it nonsymmetric
+    Matrix gridMatrix(int m, double convection){
+        Matrix result(m * m, m * m);
+        for(int y = 0; y < m; ++y)
+            for(int x = 0; x < m; ++x){
+                int i = y * m + x;
+                result.set(i, i, 4 + convection);
+                if(x > 0) result.set(i, i - 1, -1 - convection);
+                if(x + 1 < m) result.set(i, i + 1, -1);
+                if(y > 0) result.set(i, i - m, -1);
+                if(y + 1 < m) result.set(i, i + m, -1);
+            }
+        return result;
+    }
+
+    template<typename SOLVER> void requireSolves(Matrix const& a, SOLVER const& solver){
+        dmk::Random<> r(31);
+        dmk::ThreadPool pool(2);
+        dmk::Vector<double> expected(a.getRows());
+        for(int i = 0; i < a.getRows(); ++i) expected[i] = r.uniform01() - 0.5;
+        dmk::Vector<double> b = a * expected;
+        for(dmk::ThreadPool* p : {(dmk::ThreadPool*)0, &pool}){
+            dmk::KrylovMatrix<double> k(a, p);
+            dmk::JacobiPreconditioner<double> jacobi(k);
+            dmk::SymmetricGaussSeidelPreconditioner<double> sgs(k);
+            dmk::ILU0Preconditioner<double> ilu(k);
+            dmk::KrylovStatistics s[] = {solver(k, b, dmk::IdentityPreconditioner<double>()),
+                solver(k, b, jacobi), solver(k, b, sgs), solver(k, b, ilu)};
+            for(int i = 0; i < 4; ++i){
+                REQUIRE( s[i].converged );
+                REQUIRE( s[i].residual < 1e-7 );
+                REQUIRE( s[i].residuals.getSize() > 1 );
+                REQUIRE( s[i].residuals.lastItem() <= 1e-8 );
+                REQUIRE( s[i].products > s[i].iterations );
+            }
+            // better preconditioners take fewer iterations
+            REQUIRE( s[1].iterations <= s[0].iterations );
+            REQUIRE( s[2].iterations < s[1].iterations );
+            REQUIRE( s[3].iterations < s[1].iterations );
+        }
+    }
+}
+
+TEST_CASE( "Krylov solvers converge", "[sparse]" ) {
+    Matrix symmetric = gridMatrix(90, 0), convection = gridMatrix(40, 2);
+    auto check = [](dmk::Vector<double> const& x, dmk::Vector<double> const& b,
+        dmk::KrylovMatrix<double> const& k){
+        dmk::Vector<double> ax(b.getSize());
+        k.multiply(x.getArray(), ax.getArray());
+        for(int i = 0; i < b.getSize(); ++i) REQUIRE( std::abs(ax[i] - b[i]) < 1e-6 );
+    };
+    requireSolves(symmetric, [&](dmk::KrylovMatrix<double> const& k,
+        dmk::Vector<double> const& b, auto const& m){
+        dmk::Vector<double> x;
+        dmk::KrylovStatistics s = dmk::conjugateGradient(k, b, x, m, 1e-10);
+        check(x, b, k);
+        REQUIRE( s.residuals.getSize() == s.iterations + 1 );
+        return s;
+    });
+    for(Matrix const* a : {&symmetric, &convection}){
+        requireSolves(*a, [&](dmk::KrylovMatrix<double> const& k,
+            dmk::Vector<double> const& b, auto const& m){
+            dmk::Vector<double> x;
+            dmk::KrylovStatistics s = dmk::biCGStab(k, b, x, m, 1e-10);
+            check(x, b, k);
+            return s;
+        });
+        requireSolves(*a, [&](dmk::KrylovMatrix<double> const& k,
+            dmk::Vector<double> const& b, auto const& m){
+            // restarts several times
+            dmk::Vector<double> x;
+            dmk::KrylovStatistics s = dmk::gmres(k, b, x, m, 1e-10, 5000, 20);
+            check(x, b, k);
+            return s;
+        });
+    }
+
+    // ILU(0) of a tridiagonal matrix is its LU, exact
+    Matrix tridiagonal(100, 100);
+    for(int i = 0; i < 100; ++i){
+        tridiagonal.set(i, i, 3);
+        if(i > 0) tridiagonal.set(i, i - 1, -1);
+        if(i + 1 < 100) tridiagonal.set(i, i + 1, -2);
+    }
+    dmk::KrylovMatrix<double> k(tridiagonal);
+    dmk::ILU0Preconditioner<double> ilu(k);
+    dmk::Vector<double> b(100, 1), x, zero(100, 0);
+    REQUIRE( dmk::gmres(k, b, x, ilu).iterations == 1 );
+    check(x, b, k);
+    // b = 0 is solved by x = 0 at once
+    dmk::KrylovStatistics s = dmk::conjugateGradient(k, zero, x);
+    REQUIRE( (s.converged && s.iterations == 0 && s.residual == 0) );
+    for(int i = 0; i < 100; ++i) REQUIRE( x[i] == 0 );
+}
@@ -1,5 +1,12 @@
+#if __has_include(<catch2/catch_test_macros.hpp>)
 #include <catch2/catch_test_macros.hpp>
-#include "../utils/vector.hpp"
+#else
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#endif
+#include "../vector.hpp"
+#include <string>
+#include <type_traits>
 
 TEST_CASE( "vectors can be sized and resized", "[vector]" ) {
     // This setup will be done 4 times in total, once for each section
@@ -18,16 +25,66 @@ TEST_CASE( "vectors can be sized and resized", "[vector]" ) {
 /*         REQUIRE( v.size() == 0 ); */
 /*         REQUIRE( v.capacity() >= 5 ); */
 /*     } */
-/*     SECTION( "reserving bigger changes capacity but not size" ) { */
-/*         v.reserve( 10 ); */
+    SECTION( "reserving bigger changes capacity but not size" ) {
+        v.reserve( 10 );
 
-/*         REQUIRE( v.size() == 5 ); */
-/*         REQUIRE( v.capacity() >= 10 ); */
-/*     } */
-/*     SECTION( "reserving smaller does not change size or capacity" ) { */
-/*         v.reserve( 0 ); */
+        REQUIRE( v.getSize() == 5 );
+        REQUIRE( v.getCapacity() >= 10 );
+    }
+    SECTION( "reserving smaller does not change size or capacity" ) {
+        v.reserve( 0 );
 
-/*         REQUIRE( v.size() == 5 ); */
-/*         REQUIRE( v.capacity() >= 5 ); */
-/*     } */
+        REQUIRE( v.getSize() == 5 );
+        REQUIRE( v.getCapacity() >= 5 );
+    }
+    SECTION( "shrinking to fit drops spare capacity" ) {
+        v.reserve( 100 );
+        v.shrinkToFit();
+
+        REQUIRE( v.getSize() == 5 );
+        REQUIRE( v.getCapacity() == 5 );
+    }
+    SECTION( "removing all items keeps the capacity" ) {
+        v.reserve( 100 );
+        v.removeAll();
+
+        REQUIRE( v.getSize() == 0 );
+        REQUIRE( v.getCapacity() >= 100 );
+    }
+}
+
+TEST_CASE( "vectors move their items instead of copying", "[vector]" ) {
+    dmk::Vector<std::string> v;
+    for(int i = 0; i < 100; ++i) v.emplaceAppend(3, char('a' + i % 26));
+
+    SECTION( "growing keeps the items" ) {
+        REQUIRE( v.getSize() == 100 );
+        REQUIRE( v[27] == "bbb" );
+    }
+    SECTION( "appending an own item while growing is safe" ) {
+        v.shrinkToFit();
+        v.append(v[0]);
+        REQUIRE( v.lastItem() == "aaa" );
+    }
+    SECTION( "move construction steals the buffer" ) {
+        std::string const* array = v.getArray();
+        dmk::Vector<std::string> w(std::move(v));
+
+        REQUIRE( w.getArray() == array );
+        REQUIRE( w.getSize() == 100 );
+        REQUIRE( v.getSize() == 0 );
+        v.append("reused");
+        REQUIRE( v[0] == "reused" );
+    }
+    SECTION( "move assignment steals the buffer" ) {
+        dmk::Vector<std::string> w(3, "x");
+        w = std::move(v);
+
+        REQUIRE( w.getSize() == 100 );
+        REQUIRE( w[1] == "bbb" );
+    }
+    SECTION( "moves can't throw, so standard containers move vectors" ) {
+        REQUIRE( std::is_nothrow_move_constructible<dmk::Vector<std::string> >::value );
+        REQUIRE( std::is_nothrow_move_assignable<dmk::Vector<std::string> >::value );
+    }
 }
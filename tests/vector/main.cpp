@@ -1,4 +1,4 @@
-#include "../../utils/vector.hpp"
+#include "../../vector.hpp"
 
 #include <iostream>
 
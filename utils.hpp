@@ -6,18 +6,35 @@
 #include <utility>
 #include <cassert>
 #include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
 
 namespace dmk{
     inline long long ceiling(unsigned long long n, long long divisor){
         return n/divisor + bool(n % divisor);
     }
 
-    template<typename ITEM> ITEM* rawMemory(int n){
-        return (ITEM*)::operator new(sizeof(ITEM) * n);
+    template<typename ITEM> ITEM* rawMemory(std::size_t n){
+        // malloc rather than operator new so that blocks can be realloc'ed
+        ITEM* result = (ITEM*)std::malloc(sizeof(ITEM) * n);
+        if(!result && n > 0) throw std::bad_alloc();
+        return result;
     }
 
     void rawDelete(void* array);
 
+    // only for trivially copyable items, the block may move
+    template<typename ITEM> ITEM* rawReallocate(ITEM* array, std::size_t n){
+        if(n == 0){
+            rawDelete(array);
+            return nullptr;
+        }
+        ITEM* result = (ITEM*)std::realloc(array, sizeof(ITEM) * n);
+        if(!result) throw std::bad_alloc();
+        return result;
+    }
+
     template<typename ITEM> void rawDestruct(ITEM* array, int size){
         for(int i=0; i < size; i++) array[i].~ITEM();
         rawDelete(array);
@@ -54,6 +71,9 @@ namespace dmk{
         COMPARATOR c;
         ReverseComparator(COMPARATOR const& theC = COMPARATOR()) : c(theC) {}
         bool operator()(ITEM const& lhs, ITEM const& rhs) const {
+            return c(rhs, lhs);
+        }
+        bool isEqual(ITEM const& lhs, ITEM const& rhs) const {
             return c.isEqual(lhs, rhs);
         }
      };
@@ -118,6 +138,21 @@ namespace dmk{
             return lhs.getSize() < rhs.getSize();
         }
         int getSize(VECTOR const& value) const{return value.getSize();}
+
+        // The i-th item as a number of the same order plus one, 0 past the
+        // end, which the string sorts cache and bucket by. It takes up
+        // CHARACTER_BITS bits less one value, integral items of up to 32
+        // bits only.
+        typedef typename std::decay<decltype(std::declval<VECTOR const&>()[0])>::type Item;
+        enum{CHARACTER_BITS = sizeof(Item) * 8};
+        unsigned long long getCharacter(VECTOR const& value, int i) const{
+            static_assert(std::is_integral<Item>::value && sizeof(Item) <= 4,
+                "integral items of up to 32 bits");
+            typedef typename std::make_unsigned<Item>::type Word;
+            if(i >= value.getSize()) return 0;
+            Word sign = std::is_signed<Item>::value ? Word(1) << (sizeof(Word) * 8 - 1) : 0;
+            return (unsigned long long)(Word(value[i]) ^ sign) + 1;
+        }
     };
 
 
@@ -6,15 +6,39 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <cstring>
+#include <type_traits>
 #include "utils.hpp"
+#include "allocator.hpp"
 
 namespace dmk{
 
-template<typename ITEM>
-class Vector: public ArithmeticType<Vector<ITEM> >{
+template<typename ITEM, typename ALLOCATOR = DefaultAllocator>
+class Vector: public ArithmeticType<Vector<ITEM, ALLOCATOR> >{
     enum{MIN_CAPACITY = 8};
+    [[no_unique_address]] ALLOCATOR allocator; // before items, used by them
     int size, capacity;
     ITEM* items;
+
+    ITEM* allocateItems(int n){return (ITEM*)allocator.allocate(sizeof(ITEM) * n);}
+
+    void reallocate(int newCapacity){
+        assert(newCapacity >= size);
+        if constexpr(std::is_trivially_copyable<ITEM>::value)
+            items = (ITEM*)allocator.reallocate(items, sizeof(ITEM) * capacity,
+                                               sizeof(ITEM) * newCapacity);
+        else {
+            // move items over, the payload is never deep-copied
+            ITEM* oldItems = items;
+            items = newCapacity > 0 ? allocateItems(newCapacity) : nullptr;
+            for(int i = 0; i < size; ++i){
+                new(&items[i])ITEM(std::move(oldItems[i]));
+                oldItems[i].~ITEM();
+            }
+            allocator.deallocate(oldItems, sizeof(ITEM) * capacity);
+        }
+        capacity = newCapacity;
+    }
 public:
 
     ITEM* getArray(){return items;}
@@ -32,25 +56,30 @@ public:
         return items[i];
     }
 
-    explicit Vector() :
+    explicit Vector(ALLOCATOR const& theAllocator = ALLOCATOR()) :
+        allocator(theAllocator),
         size(0),
         capacity(MIN_CAPACITY),
-        items(rawMemory<ITEM>(capacity)) {}
+        items(allocateItems(capacity)) {}
 
     explicit Vector(
         int initialSize,
-        ITEM const& value = ITEM()) :
+        ITEM const& value = ITEM(),
+        ALLOCATOR const& theAllocator = ALLOCATOR()) :
+        allocator(theAllocator),
         size(0),
         capacity(std::max(initialSize, int(MIN_CAPACITY))),
-        items(rawMemory<ITEM>(capacity))
+        items(allocateItems(capacity))
     {
         for(int i = 0; i < initialSize; ++i) append(value);
     }
 
-    explicit Vector(std::initializer_list<ITEM> list) :
+    explicit Vector(std::initializer_list<ITEM> list,
+        ALLOCATOR const& theAllocator = ALLOCATOR()) :
+        allocator(theAllocator),
         size(0),
         capacity(MIN_CAPACITY),
-        items(rawMemory<ITEM>(capacity))
+        items(allocateItems(capacity))
     {
         for (auto p = list.begin(); p != list.end(); p++){
             append(*p);
@@ -58,37 +87,67 @@ public:
     }
 
     Vector(Vector const& rhs): 
+        allocator(rhs.allocator),
         size(rhs.size),
         capacity(std::max(rhs.size, int(MIN_CAPACITY))),
-        items(rawMemory<ITEM>(capacity))
+        items(allocateItems(capacity))
     {
         for(int i = 0; i < size; ++i) 
             new(&items[i])ITEM(rhs.items[i]);
     }
 
+    Vector(Vector&& rhs)noexcept: allocator(rhs.allocator), size(rhs.size),
+        capacity(rhs.capacity), items(rhs.items){
+        // rhs is left empty without a buffer
+        rhs.size = rhs.capacity = 0;
+        rhs.items = nullptr;
+    }
+
     Vector& operator=(Vector const& rhs) {
         return genericAssign(*this, rhs);
     }
 
-    ~Vector(){rawDestruct(items, size);}
+    Vector& operator=(Vector&& rhs)noexcept{
+        if(this != &rhs){
+            Vector temp(std::move(rhs));
+            swapWith(temp);
+        }
+        return *this;
+    }
+
+    ~Vector(){
+        for(int i = 0; i < size; ++i) items[i].~ITEM();
+        allocator.deallocate(items, sizeof(ITEM) * capacity);
+    }
 
     void clear() {
         while(size > 0) removeLast();
     }
-
-    void resize() {
-        ITEM* oldItems = items;
-        capacity = std::max(2*size, int(MIN_CAPACITY));
-        items = rawMemory<ITEM>(capacity);
-        for(int i =0; i < size; ++i) new(&items[i])ITEM(oldItems[i]); // copy
-        rawDestruct(oldItems, size);
+    // as clear, but keeps the capacity for refilling
+    void removeAll(){
+        for(int i = 0; i < size; ++i) items[i].~ITEM();
+        size = 0;
     }
 
-    void append(ITEM const& item) {
-        if (size >= capacity) resize();
-        new(&items[size++])ITEM(item);
+    void resize() {reallocate(std::max(2*size, int(MIN_CAPACITY)));}
+
+    void reserve(int n){if(n > capacity) reallocate(n);}
+
+    void shrinkToFit(){if(capacity > size) reallocate(size);}
+
+    template<typename... ARGUMENTS> void emplaceAppend(ARGUMENTS&&... args){
+        if (size >= capacity) {
+            // arguments may refer into items, so construct before growing
+            ITEM item(std::forward<ARGUMENTS>(args)...);
+            resize();
+            new(&items[size++])ITEM(std::move(item));
+        }
+        else new(&items[size++])ITEM(std::forward<ARGUMENTS>(args)...);
     }
 
+    void append(ITEM const& item){emplaceAppend(item);}
+    void append(ITEM&& item){emplaceAppend(std::move(item));}
+
     void removeLast() {
         assert(size > 0);
         items[--size].~ITEM();
@@ -96,6 +155,7 @@ public:
     }
 
     void swapWith(Vector& other){
+        std::swap(allocator, other.allocator);
         std::swap(items, other.items);
         std::swap(size, other.size);
         std::swap(capacity, other.capacity);